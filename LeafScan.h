@@ -0,0 +1,538 @@
+// Copyright (c) 2018 Ryan Dougherty. All rights reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Pick the widest float lanes the target compiles for. AVX2 needs the module to be built with it enabled, SSE2 is
+// always there on x86-64 and NEON on 64 bit ARM. Anything else scans one position at a time.
+#if defined(__AVX2__)
+	#include <immintrin.h>
+	#define LEAF_SCAN_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define LEAF_SCAN_SSE2 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+	#include <arm_neon.h>
+	#define LEAF_SCAN_NEON 1
+#endif
+
+namespace LeafScan
+{
+	/**
+	 * One float per lane, used when no vector instructions are available and for the positions left over after the
+	 * last full group of lanes
+	 */
+	struct FScalarLanes
+	{
+		typedef float FloatType;
+		typedef bool MaskType;
+		static const int32 Width = 1;
+
+		static FORCEINLINE FloatType Load(const float *Src) { return *Src; }
+		static FORCEINLINE FloatType Set(float Value) { return Value; }
+		static FORCEINLINE FloatType Iota() { return 0.f; }
+		static FORCEINLINE FloatType Add(FloatType A, FloatType B) { return A + B; }
+		static FORCEINLINE FloatType Sub(FloatType A, FloatType B) { return A - B; }
+		static FORCEINLINE FloatType Mul(FloatType A, FloatType B) { return A * B; }
+		static FORCEINLINE FloatType Abs(FloatType A) { return FMath::Abs(A); }
+		static FORCEINLINE MaskType LessThan(FloatType A, FloatType B) { return A < B; }
+		static FORCEINLINE MaskType LessEqual(FloatType A, FloatType B) { return A <= B; }
+		static FORCEINLINE MaskType And(MaskType A, MaskType B) { return A && B; }
+		static FORCEINLINE FloatType Select(MaskType Mask, FloatType A, FloatType B) { return Mask ? A : B; }
+		static FORCEINLINE uint32 MoveMask(MaskType Mask) { return Mask ? 1 : 0; }
+		static FORCEINLINE void Store(float *Dst, FloatType A) { *Dst = A; }
+	};
+
+#if LEAF_SCAN_AVX2
+	/** Eight floats per lane group */
+	struct FVectorLanes
+	{
+		typedef __m256 FloatType;
+		typedef __m256 MaskType;
+		static const int32 Width = 8;
+
+		static FORCEINLINE FloatType Load(const float *Src) { return _mm256_loadu_ps(Src); }
+		static FORCEINLINE FloatType Set(float Value) { return _mm256_set1_ps(Value); }
+		static FORCEINLINE FloatType Iota() { return _mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f); }
+		static FORCEINLINE FloatType Add(FloatType A, FloatType B) { return _mm256_add_ps(A, B); }
+		static FORCEINLINE FloatType Sub(FloatType A, FloatType B) { return _mm256_sub_ps(A, B); }
+		static FORCEINLINE FloatType Mul(FloatType A, FloatType B) { return _mm256_mul_ps(A, B); }
+		static FORCEINLINE FloatType Abs(FloatType A) { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), A); }
+		static FORCEINLINE MaskType LessThan(FloatType A, FloatType B) { return _mm256_cmp_ps(A, B, _CMP_LT_OQ); }
+		static FORCEINLINE MaskType LessEqual(FloatType A, FloatType B) { return _mm256_cmp_ps(A, B, _CMP_LE_OQ); }
+		static FORCEINLINE MaskType And(MaskType A, MaskType B) { return _mm256_and_ps(A, B); }
+		static FORCEINLINE FloatType Select(MaskType Mask, FloatType A, FloatType B) { return _mm256_blendv_ps(B, A, Mask); }
+		static FORCEINLINE uint32 MoveMask(MaskType Mask) { return (uint32)_mm256_movemask_ps(Mask); }
+		static FORCEINLINE void Store(float *Dst, FloatType A) { _mm256_storeu_ps(Dst, A); }
+	};
+#elif LEAF_SCAN_SSE2
+	/** Four floats per lane group */
+	struct FVectorLanes
+	{
+		typedef __m128 FloatType;
+		typedef __m128 MaskType;
+		static const int32 Width = 4;
+
+		static FORCEINLINE FloatType Load(const float *Src) { return _mm_loadu_ps(Src); }
+		static FORCEINLINE FloatType Set(float Value) { return _mm_set1_ps(Value); }
+		static FORCEINLINE FloatType Iota() { return _mm_setr_ps(0.f, 1.f, 2.f, 3.f); }
+		static FORCEINLINE FloatType Add(FloatType A, FloatType B) { return _mm_add_ps(A, B); }
+		static FORCEINLINE FloatType Sub(FloatType A, FloatType B) { return _mm_sub_ps(A, B); }
+		static FORCEINLINE FloatType Mul(FloatType A, FloatType B) { return _mm_mul_ps(A, B); }
+		static FORCEINLINE FloatType Abs(FloatType A) { return _mm_andnot_ps(_mm_set1_ps(-0.f), A); }
+		static FORCEINLINE MaskType LessThan(FloatType A, FloatType B) { return _mm_cmplt_ps(A, B); }
+		static FORCEINLINE MaskType LessEqual(FloatType A, FloatType B) { return _mm_cmple_ps(A, B); }
+		static FORCEINLINE MaskType And(MaskType A, MaskType B) { return _mm_and_ps(A, B); }
+		static FORCEINLINE FloatType Select(MaskType Mask, FloatType A, FloatType B) { return _mm_or_ps(_mm_and_ps(Mask, A), _mm_andnot_ps(Mask, B)); }
+		static FORCEINLINE uint32 MoveMask(MaskType Mask) { return (uint32)_mm_movemask_ps(Mask); }
+		static FORCEINLINE void Store(float *Dst, FloatType A) { _mm_storeu_ps(Dst, A); }
+	};
+#elif LEAF_SCAN_NEON
+	/** Four floats per lane group */
+	struct FVectorLanes
+	{
+		typedef float32x4_t FloatType;
+		typedef uint32x4_t MaskType;
+		static const int32 Width = 4;
+
+		static FORCEINLINE FloatType Load(const float *Src) { return vld1q_f32(Src); }
+		static FORCEINLINE FloatType Set(float Value) { return vdupq_n_f32(Value); }
+		static FORCEINLINE FloatType Iota() { static const float Lanes[4] = { 0.f, 1.f, 2.f, 3.f }; return vld1q_f32(Lanes); }
+		static FORCEINLINE FloatType Add(FloatType A, FloatType B) { return vaddq_f32(A, B); }
+		static FORCEINLINE FloatType Sub(FloatType A, FloatType B) { return vsubq_f32(A, B); }
+		static FORCEINLINE FloatType Mul(FloatType A, FloatType B) { return vmulq_f32(A, B); }
+		static FORCEINLINE FloatType Abs(FloatType A) { return vabsq_f32(A); }
+		static FORCEINLINE MaskType LessThan(FloatType A, FloatType B) { return vcltq_f32(A, B); }
+		static FORCEINLINE MaskType LessEqual(FloatType A, FloatType B) { return vcleq_f32(A, B); }
+		static FORCEINLINE MaskType And(MaskType A, MaskType B) { return vandq_u32(A, B); }
+		static FORCEINLINE FloatType Select(MaskType Mask, FloatType A, FloatType B) { return vbslq_f32(Mask, A, B); }
+		static FORCEINLINE uint32 MoveMask(MaskType Mask)
+		{
+			static const uint32 Bits[4] = { 1, 2, 4, 8 };
+			return vaddvq_u32(vandq_u32(Mask, vld1q_u32(Bits)));
+		}
+		static FORCEINLINE void Store(float *Dst, FloatType A) { vst1q_f32(Dst, A); }
+	};
+#else
+	typedef FScalarLanes FVectorLanes;
+#endif
+
+	/** Alignment of every coordinate array, so no group of lanes is ever split across cache lines */
+	static const uint32 Alignment = 32;
+
+	/**
+	 * Gets the squared distance from a query to every position in one group of lanes
+	 */
+	template<typename Lanes, int32 Dim>
+	FORCEINLINE typename Lanes::FloatType DistSquared(const float *const *Axes, int32 Index, const typename Lanes::FloatType *Query)
+	{
+		typename Lanes::FloatType delta = Lanes::Sub(Lanes::Load(Axes[0] + Index), Query[0]);
+		typename Lanes::FloatType distSquared = Lanes::Mul(delta, delta);
+		for (int32 axis = 1; axis < Dim; axis++)
+		{
+			delta = Lanes::Sub(Lanes::Load(Axes[axis] + Index), Query[axis]);
+			distSquared = Lanes::Add(distSquared, Lanes::Mul(delta, delta));
+		}
+		return distSquared;
+	}
+
+	/**
+	 * Splats every axis of a query across a group of lanes
+	 */
+	template<typename Lanes, int32 Dim>
+	FORCEINLINE void SetQuery(const float *Query, typename Lanes::FloatType *OutQuery)
+	{
+		for (int32 axis = 0; axis < Dim; axis++)
+			OutQuery[axis] = Lanes::Set(Query[axis]);
+	}
+
+	/**
+	 * Finds the position closest to a query. The closest distance and its index are kept per lane and only reduced
+	 * once the scan is done. Ties go to the lowest index, so the result matches a scan in order.
+	 *
+	 * @param Axes One coordinate array per axis
+	 * @param Num Number of positions
+	 * @param Query One coordinate per axis
+	 * @param OutDistSquared Squared distance to the closest position
+	 * @returns Index of the closest position, or INDEX_NONE if there are none
+	 */
+	template<int32 Dim>
+	int32 FindNearest(const float *const *Axes, int32 Num, const float *Query, float &OutDistSquared)
+	{
+		typedef FVectorLanes Lanes;
+		int32 nearestIndex = INDEX_NONE;
+		int32 i = 0;
+
+		if (Num >= Lanes::Width)
+		{
+			Lanes::FloatType query[Dim];
+			SetQuery<Lanes, Dim>(Query, query);
+
+			// Indices are tracked as floats so they select with the same masks as the distances
+			Lanes::FloatType index = Lanes::Iota();
+			Lanes::FloatType step = Lanes::Set((float)Lanes::Width);
+			Lanes::FloatType bestIndex = index;
+			Lanes::FloatType bestDist = DistSquared<Lanes, Dim>(Axes, 0, query);
+			for (i = Lanes::Width; i + Lanes::Width <= Num; i += Lanes::Width)
+			{
+				index = Lanes::Add(index, step);
+				Lanes::FloatType dist = DistSquared<Lanes, Dim>(Axes, i, query);
+				Lanes::MaskType closer = Lanes::LessThan(dist, bestDist);
+				bestDist = Lanes::Select(closer, dist, bestDist);
+				bestIndex = Lanes::Select(closer, index, bestIndex);
+			}
+
+			float laneDist[Lanes::Width];
+			float laneIndex[Lanes::Width];
+			Lanes::Store(laneDist, bestDist);
+			Lanes::Store(laneIndex, bestIndex);
+			for (int32 lane = 0; lane < Lanes::Width; lane++)
+			{
+				int32 laneNearest = (int32)laneIndex[lane];
+				if (nearestIndex == INDEX_NONE || laneDist[lane] < OutDistSquared || (laneDist[lane] == OutDistSquared && laneNearest < nearestIndex))
+				{
+					nearestIndex = laneNearest;
+					OutDistSquared = laneDist[lane];
+				}
+			}
+		}
+
+		for (; i < Num; i++)
+		{
+			float dist = DistSquared<FScalarLanes, Dim>(Axes, i, Query);
+			if (nearestIndex == INDEX_NONE || dist < OutDistSquared)
+			{
+				nearestIndex = i;
+				OutDistSquared = dist;
+			}
+		}
+		return nearestIndex;
+	}
+
+	/**
+	 * Finds the first position within a tolerance of a query on every axis
+	 *
+	 * @param Axes One coordinate array per axis
+	 * @param Num Number of positions
+	 * @param Query One coordinate per axis
+	 * @param Tolerance Largest difference allowed on each axis
+	 * @returns Index of the first matching position, or INDEX_NONE if there are none
+	 */
+	template<int32 Dim>
+	int32 FindEqual(const float *const *Axes, int32 Num, const float *Query, float Tolerance)
+	{
+		typedef FVectorLanes Lanes;
+		Lanes::FloatType query[Dim];
+		SetQuery<Lanes, Dim>(Query, query);
+		Lanes::FloatType tolerance = Lanes::Set(Tolerance);
+
+		int32 i = 0;
+		for (; i + Lanes::Width <= Num; i += Lanes::Width)
+		{
+			Lanes::MaskType equal = Lanes::LessEqual(Lanes::Abs(Lanes::Sub(Lanes::Load(Axes[0] + i), query[0])), tolerance);
+			for (int32 axis = 1; axis < Dim; axis++)
+				equal = Lanes::And(equal, Lanes::LessEqual(Lanes::Abs(Lanes::Sub(Lanes::Load(Axes[axis] + i), query[axis])), tolerance));
+
+			uint32 mask = Lanes::MoveMask(equal);
+			if (mask != 0)
+				return i + FMath::CountTrailingZeros(mask);
+		}
+
+		for (; i < Num; i++)
+		{
+			bool bEqual = true;
+			for (int32 axis = 0; axis < Dim; axis++)
+				bEqual = bEqual && FMath::Abs(Axes[axis][i] - Query[axis]) <= Tolerance;
+
+			if (bEqual)
+				return i;
+		}
+		return INDEX_NONE;
+	}
+
+	/**
+	 * Writes the squared distance from a query to every position
+	 *
+	 * @param Axes One coordinate array per axis
+	 * @param Num Number of positions
+	 * @param Query One coordinate per axis
+	 * @param OutDistSquared Buffer of at least Num floats
+	 */
+	template<int32 Dim>
+	void GetDistSquared(const float *const *Axes, int32 Num, const float *Query, float *OutDistSquared)
+	{
+		typedef FVectorLanes Lanes;
+		Lanes::FloatType query[Dim];
+		SetQuery<Lanes, Dim>(Query, query);
+
+		int32 i = 0;
+		for (; i + Lanes::Width <= Num; i += Lanes::Width)
+			Lanes::Store(OutDistSquared + i, DistSquared<Lanes, Dim>(Axes, i, query));
+
+		for (; i < Num; i++)
+			OutDistSquared[i] = DistSquared<FScalarLanes, Dim>(Axes, i, Query);
+	}
+
+	/**
+	 * Calls a visitor with the index of every position within a squared radius of a center
+	 *
+	 * @param Axes One coordinate array per axis
+	 * @param Num Number of positions
+	 * @param Center One coordinate per axis
+	 * @param RadiusSquared Squared radius around the center
+	 * @param Visitor Called as bool(int32), return false to stop the scan
+	 * @returns False if the visitor stopped the scan early
+	 */
+	template<int32 Dim, typename VisitorType>
+	bool ForEachInSphere(const float *const *Axes, int32 Num, const float *Center, float RadiusSquared, VisitorType &Visitor)
+	{
+		typedef FVectorLanes Lanes;
+		Lanes::FloatType center[Dim];
+		SetQuery<Lanes, Dim>(Center, center);
+		Lanes::FloatType radiusSquared = Lanes::Set(RadiusSquared);
+
+		int32 i = 0;
+		for (; i + Lanes::Width <= Num; i += Lanes::Width)
+		{
+			uint32 mask = Lanes::MoveMask(Lanes::LessEqual(DistSquared<Lanes, Dim>(Axes, i, center), radiusSquared));
+			for (; mask != 0; mask &= mask - 1)
+			{
+				if (!Visitor(i + (int32)FMath::CountTrailingZeros(mask)))
+					return false;
+			}
+		}
+
+		for (; i < Num; i++)
+		{
+			if (DistSquared<FScalarLanes, Dim>(Axes, i, Center) <= RadiusSquared && !Visitor(i))
+				return false;
+		}
+		return true;
+	}
+
+	/**
+	 * Calls a visitor with the index of every position inside a box, inclusive of its edges
+	 *
+	 * @param Axes One coordinate array per axis
+	 * @param Num Number of positions
+	 * @param Min Smallest corner of the box, one coordinate per axis
+	 * @param Max Largest corner of the box, one coordinate per axis
+	 * @param Visitor Called as bool(int32), return false to stop the scan
+	 * @returns False if the visitor stopped the scan early
+	 */
+	template<int32 Dim, typename VisitorType>
+	bool ForEachInBox(const float *const *Axes, int32 Num, const float *Min, const float *Max, VisitorType &Visitor)
+	{
+		typedef FVectorLanes Lanes;
+		Lanes::FloatType boxMin[Dim];
+		Lanes::FloatType boxMax[Dim];
+		SetQuery<Lanes, Dim>(Min, boxMin);
+		SetQuery<Lanes, Dim>(Max, boxMax);
+
+		int32 i = 0;
+		for (; i + Lanes::Width <= Num; i += Lanes::Width)
+		{
+			Lanes::FloatType coord = Lanes::Load(Axes[0] + i);
+			Lanes::MaskType inside = Lanes::And(Lanes::LessEqual(boxMin[0], coord), Lanes::LessEqual(coord, boxMax[0]));
+			for (int32 axis = 1; axis < Dim; axis++)
+			{
+				coord = Lanes::Load(Axes[axis] + i);
+				inside = Lanes::And(inside, Lanes::And(Lanes::LessEqual(boxMin[axis], coord), Lanes::LessEqual(coord, boxMax[axis])));
+			}
+
+			for (uint32 mask = Lanes::MoveMask(inside); mask != 0; mask &= mask - 1)
+			{
+				if (!Visitor(i + (int32)FMath::CountTrailingZeros(mask)))
+					return false;
+			}
+		}
+
+		for (; i < Num; i++)
+		{
+			bool bInside = true;
+			for (int32 axis = 0; axis < Dim; axis++)
+				bInside = bInside && Min[axis] <= Axes[axis][i] && Axes[axis][i] <= Max[axis];
+
+			if (bInside && !Visitor(i))
+				return false;
+		}
+		return true;
+	}
+}
+
+/**
+ * TLeafCoords stores the positions held by one tree node as one aligned array per axis, so whole groups of positions
+ * can be loaded into vector registers and scanned at once
+ */
+template<int32 Dim, typename VectorType>
+class TLeafCoords
+{
+public:
+	/**
+	 * Gets the number of positions stored
+	 */
+	FORCEINLINE int32 Num() const
+	{
+		return axes[0].Num();
+	}
+
+	/**
+	 * Gets a position
+	 *
+	 * @param Index Index of the position
+	 * @returns The position
+	 */
+	FORCEINLINE VectorType Get(int32 Index) const
+	{
+		VectorType position;
+		for (int32 axis = 0; axis < Dim; axis++)
+			position[axis] = axes[axis][Index];
+		return position;
+	}
+
+	/**
+	 * Overwrites a position
+	 *
+	 * @param Index Index of the position
+	 * @param Position New value of the position
+	 */
+	FORCEINLINE void Set(int32 Index, const VectorType &Position)
+	{
+		for (int32 axis = 0; axis < Dim; axis++)
+			axes[axis][Index] = Position[axis];
+	}
+
+	/**
+	 * Adds a position to the end
+	 *
+	 * @param Position Position to add
+	 */
+	FORCEINLINE void Add(const VectorType &Position)
+	{
+		for (int32 axis = 0; axis < Dim; axis++)
+			axes[axis].Add(Position[axis]);
+	}
+
+	/**
+	 * Removes a position, moving the last one into its place
+	 *
+	 * @param Index Index of the position to remove
+	 */
+	FORCEINLINE void RemoveAtSwap(int32 Index)
+	{
+		for (int32 axis = 0; axis < Dim; axis++)
+			axes[axis].RemoveAtSwap(Index);
+	}
+
+	/**
+	 * Removes every position
+	 */
+	FORCEINLINE void Empty()
+	{
+		for (int32 axis = 0; axis < Dim; axis++)
+			axes[axis].Empty();
+	}
+
+	/**
+	 * Appends every position to a list in order
+	 *
+	 * @param OutPositions List the positions are appended to
+	 */
+	void AppendTo(TArray<VectorType> &OutPositions) const
+	{
+		for (int32 i = 0; i < Num(); i++)
+			OutPositions.Add(Get(i));
+	}
+
+	/**
+	 * Finds the position closest to a query
+	 *
+	 * @param Position Position to search around
+	 * @param OutDistSquared Squared distance to the closest position
+	 * @returns Index of the closest position, or INDEX_NONE if there are none
+	 */
+	FORCEINLINE int32 FindNearest(const VectorType &Position, float &OutDistSquared) const
+	{
+		const float *axisData[Dim];
+		float query[Dim];
+		Unpack(Position, axisData, query);
+		return LeafScan::FindNearest<Dim>(axisData, Num(), query, OutDistSquared);
+	}
+
+	/**
+	 * Finds the first position equal to a query within a tolerance, matching VectorType::Equals
+	 *
+	 * @param Position Position to look for
+	 * @param Tolerance Largest difference allowed on each axis
+	 * @returns Index of the first matching position, or INDEX_NONE if there are none
+	 */
+	FORCEINLINE int32 FindEqual(const VectorType &Position, float Tolerance = KINDA_SMALL_NUMBER) const
+	{
+		const float *axisData[Dim];
+		float query[Dim];
+		Unpack(Position, axisData, query);
+		return LeafScan::FindEqual<Dim>(axisData, Num(), query, Tolerance);
+	}
+
+	/**
+	 * Writes the squared distance from a query to every position
+	 *
+	 * @param Position Position to measure from
+	 * @param OutDistSquared Buffer of at least Num floats
+	 */
+	FORCEINLINE void GetDistSquared(const VectorType &Position, float *OutDistSquared) const
+	{
+		const float *axisData[Dim];
+		float query[Dim];
+		Unpack(Position, axisData, query);
+		LeafScan::GetDistSquared<Dim>(axisData, Num(), query, OutDistSquared);
+	}
+
+	/**
+	 * Calls a visitor with the index of every position within a squared radius of a center
+	 *
+	 * @returns False if the visitor stopped the scan early
+	 */
+	template<typename VisitorType>
+	FORCEINLINE bool ForEachInSphere(const VectorType &Center, float RadiusSquared, VisitorType &&Visitor) const
+	{
+		const float *axisData[Dim];
+		float center[Dim];
+		Unpack(Center, axisData, center);
+		return LeafScan::ForEachInSphere<Dim>(axisData, Num(), center, RadiusSquared, Visitor);
+	}
+
+	/**
+	 * Calls a visitor with the index of every position inside a box
+	 *
+	 * @returns False if the visitor stopped the scan early
+	 */
+	template<typename VisitorType>
+	FORCEINLINE bool ForEachInBox(const VectorType &Min, const VectorType &Max, VisitorType &&Visitor) const
+	{
+		const float *axisData[Dim];
+		float boxMin[Dim];
+		float boxMax[Dim];
+		Unpack(Min, axisData, boxMin);
+		for (int32 axis = 0; axis < Dim; axis++)
+			boxMax[axis] = Max[axis];
+		return LeafScan::ForEachInBox<Dim>(axisData, Num(), boxMin, boxMax, Visitor);
+	}
+
+private:
+	/**
+	 * Gathers the coordinate arrays and splits a vector into one float per axis for the kernels
+	 */
+	FORCEINLINE void Unpack(const VectorType &Position, const float **OutAxes, float *OutCoords) const
+	{
+		for (int32 axis = 0; axis < Dim; axis++)
+		{
+			OutAxes[axis] = axes[axis].GetData();
+			OutCoords[axis] = Position[axis];
+		}
+	}
+
+	/** One coordinate per position for each axis, stored at the same index */
+	TArray<float, TAlignedHeapAllocator<LeafScan::Alignment>> axes[Dim];
+};
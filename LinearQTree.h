@@ -0,0 +1,850 @@
+// Copyright (c) 2018 Ryan Dougherty. All rights reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Morton.h"
+#include "SplitPolicy.h"
+#include "Async/ParallelFor.h"
+#include "Serialization/Archive.h"
+#include "Runtime/Engine/Classes/GameFramework/Actor.h"
+
+/**
+ * LinearQTree is a pointer free Quad Tree stored as one flat array of Actors sorted by the Morton code of their
+ * quantized position. Every quad tree node is an implicit range of that array, so queries walk sequential memory
+ * instead of following child pointers.
+ * Building is an O(n) radix sort, while single adds and removes shift the array and cost O(n), so this is best
+ * suited to large sets of Actors that rarely change, such as the spawn points of a level.
+ */
+class LinearQTree
+{
+public:
+	/**
+	 * Default constructor for empty tree
+	 *
+	 * @param bucketSize Largest number of Actors a node holds before it is treated as having children
+	 */
+	LinearQTree(int bucketSize = 8) : data(), positions(), codes(), policy(bucketSize), maxSplitLevel(MaxLevel)
+	{
+		this->minBounds = FVector2D::ZeroVector;
+		this->maxBounds = FVector2D::ZeroVector;
+		this->cellSize = FVector2D::UnitVector;
+	}
+
+	/**
+	 * Rebuilds the tree from scratch with a new list of Actors
+	 *
+	 * @param Actors List of all actors to store in the tree
+	 */
+	void Build(const TArray<AActor*> &Actors)
+	{
+		// Actors listed more than once are only stored the first time
+		TArray<AActor*> uniqueActors;
+		TArray<FVector2D> actorPositions;
+		TSet<AActor*> seen;
+		uniqueActors.Reserve(Actors.Num());
+		actorPositions.Reserve(Actors.Num());
+		seen.Reserve(Actors.Num());
+		for (AActor *act : Actors)
+		{
+			if (seen.Contains(act))
+				continue;
+
+			seen.Add(act);
+			FVector actorLocation = act->GetActorLocation();
+			uniqueActors.Add(act);
+			actorPositions.Add(FVector2D(actorLocation.X, actorLocation.Y));
+		}
+
+		BuildFromEntries(uniqueActors, actorPositions);
+	}
+
+	/**
+	 * Adds an actor to the tree
+	 *
+	 * @param Act Actor to be added into the tree
+	 */
+	FORCEINLINE bool Add(AActor *Act)
+	{
+		FVector actorLocation = Act->GetActorLocation();
+		return Add(Act, FVector2D(actorLocation.X, actorLocation.Y));
+	}
+
+	/**
+	 * Adds an actor to the tree at an explicit position. Adding outside of the current bounds re-quantizes and
+	 * re-sorts every Actor.
+	 *
+	 * @param Act Actor to be added into the tree
+	 * @param Position 2D position to index the actor at
+	 */
+	bool Add(AActor *Act, FVector2D Position)
+	{
+		if (data.Num() == 0 || !IsInBounds(Position))
+		{
+			TArray<AActor*> allActs = data;
+			TArray<FVector2D> allPositions = positions;
+			allActs.Add(Act);
+			allPositions.Add(Position);
+			BuildFromEntries(allActs, allPositions);
+			return true;
+		}
+
+		// Keep the arrays sorted by inserting after every entry with the same code
+		uint32 code = GetCode(Position);
+		int32 index = UpperBound(code, 0, codes.Num());
+		data.Insert(Act, index);
+		positions.Insert(Position, index);
+		codes.Insert(code, index);
+		return true;
+	}
+
+	/**
+	 * Adds a list of actors to the tree with a single rebuild
+	 *
+	 * @param Actors List of all actors to add to the tree
+	 */
+	bool Add(const TArray<AActor*> &Actors)
+	{
+		TArray<AActor*> allActs = data;
+		TArray<FVector2D> allPositions = positions;
+		for (AActor *act : Actors)
+		{
+			FVector actorLocation = act->GetActorLocation();
+			allActs.Add(act);
+			allPositions.Add(FVector2D(actorLocation.X, actorLocation.Y));
+		}
+
+		BuildFromEntries(allActs, allPositions);
+		return true;
+	}
+
+	/**
+	 * Removes an actor from the tree
+	 *
+	 * @param Position Position of Actor to remove from the tree
+	 * @returns True if successfully removes an Actor in the tree at the given position
+	 */
+	bool Remove(FVector2D Position)
+	{
+		int32 index = FindIndex(Position);
+		if (index == INDEX_NONE)
+			return false;
+
+		data.RemoveAt(index);
+		positions.RemoveAt(index);
+		codes.RemoveAt(index);
+		return true;
+	}
+
+	/**
+	 * Removes a specific actor from the tree
+	 *
+	 * @param Act Actor to remove from the tree
+	 * @returns True if the actor was found and removed
+	 */
+	bool Remove(AActor *Act)
+	{
+		int32 index = data.Find(Act);
+		if (index == INDEX_NONE)
+			return false;
+
+		data.RemoveAt(index);
+		positions.RemoveAt(index);
+		codes.RemoveAt(index);
+		return true;
+	}
+
+	/**
+	 * Finds an actor in the tree based of off 2D position
+	 *
+	 * @param Position Position of Actor to find in the tree
+	 * @returns Actor in tree at given position
+	 */
+	FORCEINLINE AActor * Find(FVector2D Position) const
+	{
+		int32 index = FindIndex(Position);
+		return index == INDEX_NONE ? NULL : data[index];
+	}
+
+	/**
+	 * Finds an actor in the tree closest to the desired position
+	 *
+	 * @param Position Position closest to the nearest Actor in the tree
+	 * @returns Actor in tree at nearest position
+	 */
+	FORCEINLINE AActor * FindNearest(FVector2D Position) const
+	{
+		AActor *nearest = NULL;
+		FindKNearest(Position, 1, MAX_FLT, MakeArrayView(&nearest, 1));
+		return nearest;
+	}
+
+	/**
+	 * Finds the actor closest to each of a list of positions. The positions are sorted by the same Morton codes as
+	 * the tree and split into runs that are searched in parallel, so each worker walks a compact range of entries.
+	 * The tree must not be changed until the call returns.
+	 *
+	 * @param Queries Positions to search around
+	 * @param OutNearest Caller owned buffer the nearest actor to each query is written to, at the same index
+	 */
+	void FindNearestBatch(TArrayView<const FVector2D> Queries, TArrayView<AActor*> OutNearest) const
+	{
+		int32 num = FMath::Min(Queries.Num(), OutNearest.Num());
+
+		TArray<uint32> queryCodes;
+		queryCodes.SetNumUninitialized(num);
+		for (int32 i = 0; i < num; i++)
+			queryCodes[i] = GetCode(Queries[i]);
+
+		TArray<int32> order;
+		FMorton::RadixSort(queryCodes, order);
+
+		// Runs are long enough to amortize scheduling and short enough to balance across workers
+		const int32 QueriesPerRun = 64;
+		int32 numRuns = (num + QueriesPerRun - 1) / QueriesPerRun;
+		ParallelFor(numRuns, [&](int32 Run)
+		{
+			int32 end = FMath::Min((Run + 1) * QueriesPerRun, num);
+			for (int32 i = Run * QueriesPerRun; i < end; i++)
+			{
+				int32 query = order[i];
+				OutNearest[query] = FindNearest(Queries[query]);
+			}
+		}, numRuns <= 1);
+	}
+
+	/**
+	 * Finds the K actors in the tree closest to the desired position, searching the implicit nodes best-first
+	 *
+	 * @param Position Position to search around
+	 * @param K Maximum number of actors to find
+	 * @param MaxDistance Actors further away from the position than this are ignored
+	 * @param OutNearest Caller owned buffer the nearest actors are written to, closest first
+	 * @returns The number of actors written to OutNearest
+	 */
+	int32 FindKNearest(FVector2D Position, int32 K, float MaxDistance, TArrayView<AActor*> OutNearest) const
+	{
+		return FindKNearest(Position, K, MaxDistance, OutNearest, [](AActor*) { return true; });
+	}
+
+	/**
+	 * Finds the K actors in the tree closest to the desired position that also pass a filter. Rejected actors are
+	 * skipped during the search, so up to K accepted actors are always returned. The layout is flat and read only, so
+	 * this is how closed actors are left out instead of per actor enabled bits.
+	 *
+	 * @param Position Position to search around
+	 * @param K Maximum number of actors to find
+	 * @param MaxDistance Actors further away from the position than this are ignored
+	 * @param OutNearest Caller owned buffer the nearest actors are written to, closest first
+	 * @param Filter Callable as bool(AActor*), returning false for actors that must not be returned
+	 * @returns The number of actors written to OutNearest
+	 */
+	template<typename FilterType>
+	int32 FindKNearest(FVector2D Position, int32 K, float MaxDistance, TArrayView<AActor*> OutNearest, FilterType &&Filter) const
+	{
+		K = FMath::Min(K, OutNearest.Num());
+		if (K <= 0 || data.Num() == 0)
+			return 0;
+
+		// Nodes still to visit, ordered so the closest node is always on top
+		TArray<FNodeCandidate, TInlineAllocator<64>> nodeQueue;
+		auto closestNodeFirst = [](const FNodeCandidate &A, const FNodeCandidate &B) { return A.DistSquared < B.DistSquared; };
+
+		// Best actors found so far, ordered so the furthest one is on top and can be evicted
+		TArray<FActorCandidate, TInlineAllocator<16>> found;
+		auto furthestActorFirst = [](const FActorCandidate &A, const FActorCandidate &B) { return A.DistSquared > B.DistSquared; };
+
+		float cutoff = MaxDistance < MAX_FLT ? FMath::Square(MaxDistance) : MAX_FLT;
+		FNodeRange root = GetRootNode();
+		nodeQueue.HeapPush(FNodeCandidate{ GetDistSquaredToNode(Position, root), root }, closestNodeFirst);
+
+		while (nodeQueue.Num() > 0)
+		{
+			FNodeCandidate candidate;
+			nodeQueue.HeapPop(candidate, closestNodeFirst, false);
+
+			// Every remaining node is at least this far away, so nothing left can beat the current results
+			if (candidate.DistSquared > cutoff)
+				break;
+
+			const FNodeRange &node = candidate.Node;
+			if (IsLeaf(node))
+			{
+				for (int32 i = node.Begin; i < node.End; i++)
+				{
+					float distance = FVector2D::DistSquared(Position, positions[i]);
+					if (distance > cutoff || !Filter(data[i]))
+						continue;
+
+					found.HeapPush(FActorCandidate{ distance, data[i] }, furthestActorFirst);
+					if (found.Num() > K)
+						found.HeapPopDiscard(furthestActorFirst, false);
+
+					// Once K actors are known, only closer ones are worth looking for
+					if (found.Num() == K)
+						cutoff = found.HeapTop().DistSquared;
+				}
+				continue;
+			}
+
+			FNodeRange children[4];
+			int32 numChildren = SplitNode(node, children);
+			for (int32 i = 0; i < numChildren; i++)
+			{
+				float childDist = GetDistSquaredToNode(Position, children[i]);
+				if (childDist <= cutoff)
+					nodeQueue.HeapPush(FNodeCandidate{ childDist, children[i] }, closestNodeFirst);
+			}
+		}
+
+		// Write the results out closest first
+		int32 numFound = found.Num();
+		for (int32 i = numFound - 1; i >= 0; i--)
+		{
+			OutNearest[i] = found.HeapTop().Actor;
+			found.HeapPopDiscard(furthestActorFirst, false);
+		}
+		return numFound;
+	}
+
+	/**
+	 * Visits every actor inside an axis aligned rectangle
+	 *
+	 * @param Min Smallest corner of the rectangle
+	 * @param Max Largest corner of the rectangle
+	 * @param Visitor Called as bool(AActor*, const FVector2D&) for each actor found, return false to stop the query
+	 * @returns False if the visitor stopped the query early
+	 */
+	template<typename VisitorType>
+	FORCEINLINE bool QueryRect(FVector2D Min, FVector2D Max, VisitorType &&Visitor) const
+	{
+		if (data.Num() == 0)
+			return true;
+
+		return QueryRectRecursive(GetRootNode(), Min, Max, Visitor);
+	}
+
+	/**
+	 * Visits every actor within a radius of a position
+	 *
+	 * @param Center Center of the circle
+	 * @param Radius Radius of the circle
+	 * @param Visitor Called as bool(AActor*, const FVector2D&) for each actor found, return false to stop the query
+	 * @returns False if the visitor stopped the query early
+	 */
+	template<typename VisitorType>
+	FORCEINLINE bool QueryRadius(FVector2D Center, float Radius, VisitorType &&Visitor) const
+	{
+		if (data.Num() == 0)
+			return true;
+
+		return QueryRadiusRecursive(GetRootNode(), Center, FMath::Square(Radius), Visitor);
+	}
+
+	/**
+	 * Returns an array of all Actors in the tree
+	 *
+	 * @returns An array of all of the Actors in the tree, in Morton order
+	 */
+	FORCEINLINE TArray<class AActor*> GetAllActors() const
+	{
+		return data;
+	}
+
+	/**
+	 * Gets the number of Actors in the tree
+	 *
+	 * @returns Number of Actors in the tree
+	 */
+	FORCEINLINE int32 Num() const
+	{
+		return data.Num();
+	}
+
+	/**
+	 * Gets an Actor by its index in Morton order
+	 *
+	 * @param Index Index of the Actor, from 0 to Num() - 1
+	 * @returns The Actor at that index
+	 */
+	FORCEINLINE AActor * GetActorAt(int32 Index) const
+	{
+		return data[Index];
+	}
+
+	/**
+	 * Picks an Actor uniformly at random in O(1), without allocating
+	 *
+	 * @returns A random Actor, or NULL if the tree is empty
+	 */
+	FORCEINLINE AActor * GetRandomActor() const
+	{
+		return data.Num() > 0 ? data[FMath::RandRange(0, data.Num() - 1)] : NULL;
+	}
+
+	/**
+	 * Removes every actor from the tree
+	 */
+	FORCEINLINE void Empty()
+	{
+		data.Empty();
+		positions.Empty();
+		codes.Empty();
+	}
+
+	/**
+	 * Changes the rules deciding which nodes are split. Actors already in the tree are sorted again under the new
+	 * rules.
+	 *
+	 * @param Policy New split policy for the tree
+	 */
+	void SetSplitPolicy(const FSplitPolicy &Policy)
+	{
+		policy = Policy;
+
+		TArray<AActor*> oldData = data;
+		TArray<FVector2D> oldPositions = positions;
+		BuildFromEntries(oldData, oldPositions);
+	}
+
+	/**
+	 * Makes a copy of the tree
+	 *
+	 * @returns The copy, owned by the caller
+	 */
+	FORCEINLINE LinearQTree * Clone() const
+	{
+		return new LinearQTree(*this);
+	}
+
+	/**
+	 * Gets the rules deciding which nodes are split
+	 *
+	 * @returns The tree's split policy
+	 */
+	FORCEINLINE const FSplitPolicy & GetSplitPolicy() const
+	{
+		return policy;
+	}
+
+	/**
+	 * Writes the tree exactly as it is stored: the grid, the split policy and the sorted entries, each array in one
+	 * block. Actors are written as their index in a table the caller keeps alongside, so the result can be loaded in
+	 * another session without sorting anything again.
+	 *
+	 * @param Ar Archive to write to
+	 * @param ActorIndices Index of every Actor in the tree in the caller's table
+	 * @returns False if an Actor in the tree has no index
+	 */
+	bool Save(FArchive &Ar, const TMap<AActor*, int32> &ActorIndices) const
+	{
+		TArray<int32> actorIndices;
+		actorIndices.SetNumUninitialized(data.Num());
+		for (int32 i = 0; i < data.Num(); i++)
+		{
+			const int32 *actorIndex = ActorIndices.Find(data[i]);
+			if (actorIndex == NULL)
+				return false;
+
+			actorIndices[i] = *actorIndex;
+		}
+
+		uint32 version = FormatVersion;
+		int32 num = data.Num();
+		FSplitPolicy savedPolicy = policy;
+		int32 savedMaxSplitLevel = maxSplitLevel;
+		FVector2D savedMin = minBounds, savedMax = maxBounds, savedCellSize = cellSize;
+		Ar << version << num;
+		Ar << savedPolicy.LeafCapacity << savedPolicy.MaxDepth << savedPolicy.MinCellSize << savedMaxSplitLevel;
+		Ar << savedMin << savedMax << savedCellSize;
+		Ar.Serialize(actorIndices.GetData(), num * sizeof(int32));
+		Ar.Serialize(const_cast<FVector2D*>(positions.GetData()), num * sizeof(FVector2D));
+		Ar.Serialize(const_cast<uint32*>(codes.GetData()), num * sizeof(uint32));
+		return !Ar.IsError();
+	}
+
+	/**
+	 * Replaces the contents of the tree with one written by Save. Nothing is sorted or quantized again, every array
+	 * is read in one block.
+	 *
+	 * @param Ar Archive to read from
+	 * @param Actors Table the Actor indices were written against
+	 * @returns False if the data was written by another version, is cut short, or refers to an Actor not in the table,
+	 * in which case the tree is left empty
+	 */
+	bool Load(FArchive &Ar, TArrayView<AActor* const> Actors)
+	{
+		Empty();
+
+		uint32 version = 0;
+		int32 num = 0;
+		Ar << version;
+		if (version != FormatVersion)
+			return false;
+
+		Ar << num;
+		Ar << policy.LeafCapacity << policy.MaxDepth << policy.MinCellSize << maxSplitLevel;
+		Ar << minBounds << maxBounds << cellSize;
+		if (Ar.IsError() || num < 0 || Ar.TotalSize() - Ar.Tell() < num * (int64)(sizeof(int32) + sizeof(FVector2D) + sizeof(uint32)))
+			return false;
+
+		TArray<int32> actorIndices;
+		actorIndices.SetNumUninitialized(num);
+		positions.SetNumUninitialized(num);
+		codes.SetNumUninitialized(num);
+		Ar.Serialize(actorIndices.GetData(), num * sizeof(int32));
+		Ar.Serialize(positions.GetData(), num * sizeof(FVector2D));
+		Ar.Serialize(codes.GetData(), num * sizeof(uint32));
+
+		data.SetNumUninitialized(num);
+		for (int32 i = 0; i < num; i++)
+		{
+			if (!Actors.IsValidIndex(actorIndices[i]))
+			{
+				Empty();
+				return false;
+			}
+			data[i] = Actors[actorIndices[i]];
+		}
+
+		if (Ar.IsError())
+		{
+			Empty();
+			return false;
+		}
+		return true;
+	}
+
+private:
+	/** Number of times the root can be split before reaching a single quantization cell */
+	static const int32 MaxLevel = FMorton::BitsPerAxis2D;
+
+	/** Version of the layout Save writes. Bump it whenever the layout changes so older data is rebuilt instead */
+	static const uint32 FormatVersion = 1;
+
+	/** Implicit node of the tree: a square block of quantization cells and the range of entries inside it */
+	struct FNodeRange
+	{
+		/** Morton code of the node with the bits below its level dropped */
+		uint32 Prefix;
+
+		/** Depth of the node, the root is at level 0 */
+		int32 Level;
+
+		/** First entry in the node */
+		int32 Begin;
+
+		/** One past the last entry in the node */
+		int32 End;
+	};
+
+	/** Node waiting to be searched by FindKNearest */
+	struct FNodeCandidate
+	{
+		float DistSquared;
+		FNodeRange Node;
+	};
+
+	/** Actor found by FindKNearest */
+	struct FActorCandidate
+	{
+		float DistSquared;
+		AActor *Actor;
+	};
+
+	/**
+	 * Quantizes positions into cells, sorts them by Morton code and stores the result as the tree's contents
+	 *
+	 * @param Actors Actors to store
+	 * @param ActorPositions Position of each Actor, stored at the same index
+	 */
+	void BuildFromEntries(const TArray<AActor*> &Actors, const TArray<FVector2D> &ActorPositions)
+	{
+		int32 num = Actors.Num();
+		Empty();
+		if (num == 0)
+			return;
+
+		// Fit the bounds around every position in one pass
+		minBounds = ActorPositions[0];
+		maxBounds = ActorPositions[0];
+		for (const FVector2D &pos : ActorPositions)
+		{
+			minBounds.X = FMath::Min(minBounds.X, pos.X);
+			minBounds.Y = FMath::Min(minBounds.Y, pos.Y);
+			maxBounds.X = FMath::Max(maxBounds.X, pos.X);
+			maxBounds.Y = FMath::Max(maxBounds.Y, pos.Y);
+		}
+
+		// Spread the bounds over the full grid, keeping a usable cell size when every point shares an axis
+		const float numCells = (float)(1 << MaxLevel);
+		cellSize.X = FMath::Max((maxBounds.X - minBounds.X) / numCells, KINDA_SMALL_NUMBER);
+		cellSize.Y = FMath::Max((maxBounds.Y - minBounds.Y) / numCells, KINDA_SMALL_NUMBER);
+
+		// Find the deepest level the split policy lets nodes split from
+		float rootSize = FMath::Max(cellSize.X, cellSize.Y) * numCells;
+		maxSplitLevel = FMath::Min(policy.MaxDepth, MaxLevel);
+		while (maxSplitLevel > 0 && !policy.CanSplit(maxSplitLevel - 1, rootSize / (float)(1 << (maxSplitLevel - 1))))
+			maxSplitLevel--;
+
+		TArray<uint32> unsortedCodes;
+		unsortedCodes.SetNumUninitialized(num);
+		for (int32 i = 0; i < num; i++)
+			unsortedCodes[i] = GetCode(ActorPositions[i]);
+
+		TArray<int32> order;
+		FMorton::RadixSort(unsortedCodes, order);
+
+		data.SetNumUninitialized(num);
+		positions.SetNumUninitialized(num);
+		codes.SetNumUninitialized(num);
+		for (int32 i = 0; i < num; i++)
+		{
+			data[i] = Actors[order[i]];
+			positions[i] = ActorPositions[order[i]];
+			codes[i] = unsortedCodes[order[i]];
+		}
+	}
+
+	/**
+	 * Checks whether a position can be quantized without moving the bounds
+	 */
+	FORCEINLINE bool IsInBounds(FVector2D Position) const
+	{
+		return Position.X >= minBounds.X && Position.X <= maxBounds.X && Position.Y >= minBounds.Y && Position.Y <= maxBounds.Y;
+	}
+
+	/**
+	 * Gets the Morton code of the cell a position falls in
+	 */
+	FORCEINLINE uint32 GetCode(FVector2D Position) const
+	{
+		const int32 lastCell = (1 << MaxLevel) - 1;
+		uint32 x = (uint32)FMath::Clamp(FMath::FloorToInt((Position.X - minBounds.X) / cellSize.X), 0, lastCell);
+		uint32 y = (uint32)FMath::Clamp(FMath::FloorToInt((Position.Y - minBounds.Y) / cellSize.Y), 0, lastCell);
+		return FMorton::Encode2D(x, y);
+	}
+
+	/**
+	 * Finds the index of the entry at a position
+	 *
+	 * @returns Index of the matching entry or INDEX_NONE
+	 */
+	int32 FindIndex(FVector2D Position) const
+	{
+		if (data.Num() == 0 || !IsInBounds(Position))
+			return INDEX_NONE;
+
+		// Only entries in the same cell can match
+		uint32 code = GetCode(Position);
+		for (int32 i = LowerBound(code, 0, codes.Num()); i < codes.Num() && codes[i] == code; i++)
+		{
+			if (Position.Equals(positions[i]))
+				return i;
+		}
+		return INDEX_NONE;
+	}
+
+	/**
+	 * Gets the first index in [Begin, End) whose code is not less than Code
+	 */
+	FORCEINLINE int32 LowerBound(uint64 Code, int32 Begin, int32 End) const
+	{
+		while (Begin < End)
+		{
+			int32 mid = Begin + (End - Begin) / 2;
+			if ((uint64)codes[mid] < Code)
+				Begin = mid + 1;
+			else
+				End = mid;
+		}
+		return Begin;
+	}
+
+	/**
+	 * Gets the first index in [Begin, End) whose code is greater than Code
+	 */
+	FORCEINLINE int32 UpperBound(uint32 Code, int32 Begin, int32 End) const
+	{
+		return LowerBound((uint64)Code + 1, Begin, End);
+	}
+
+	/**
+	 * Gets the node covering the entire tree
+	 */
+	FORCEINLINE FNodeRange GetRootNode() const
+	{
+		return FNodeRange{ 0, 0, 0, data.Num() };
+	}
+
+	/**
+	 * Checks whether a node's entries should be scanned directly instead of being split further
+	 */
+	FORCEINLINE bool IsLeaf(const FNodeRange &Node) const
+	{
+		return Node.End - Node.Begin <= policy.LeafCapacity || Node.Level >= maxSplitLevel;
+	}
+
+	/**
+	 * Splits a node into its non empty children
+	 *
+	 * @param Node Node to split
+	 * @param OutChildren Filled with the children of the node in Morton order
+	 * @returns The number of children written to OutChildren
+	 */
+	int32 SplitNode(const FNodeRange &Node, FNodeRange OutChildren[4]) const
+	{
+		int32 numChildren = 0;
+		int32 childShift = 2 * (MaxLevel - Node.Level - 1);
+		int32 begin = Node.Begin;
+
+		for (uint32 quad = 0; quad < 4; quad++)
+		{
+			uint32 childPrefix = (Node.Prefix << 2) | quad;
+
+			// Each child ends where the codes of the next child begin
+			int32 end = quad == 3 ? Node.End : LowerBound((uint64)(childPrefix + 1) << childShift, begin, Node.End);
+			if (end > begin)
+				OutChildren[numChildren++] = FNodeRange{ childPrefix, Node.Level + 1, begin, end };
+			begin = end;
+		}
+		return numChildren;
+	}
+
+	/**
+	 * Gets the world space boundary of a node
+	 *
+	 * @param Node Node to get the boundary of
+	 * @param OutMin Smallest corner of the node
+	 * @param OutMax Largest corner of the node
+	 */
+	FORCEINLINE void GetNodeBounds(const FNodeRange &Node, FVector2D &OutMin, FVector2D &OutMax) const
+	{
+		uint32 cellX, cellY;
+		FMorton::Decode2D(Node.Prefix, cellX, cellY);
+
+		int32 shift = MaxLevel - Node.Level;
+		float cellsPerNode = (float)(1 << shift);
+		OutMin = FVector2D(minBounds.X + (float)(cellX << shift) * cellSize.X, minBounds.Y + (float)(cellY << shift) * cellSize.Y);
+		OutMax = FVector2D(OutMin.X + cellsPerNode * cellSize.X, OutMin.Y + cellsPerNode * cellSize.Y);
+	}
+
+	/**
+	 * Gets the squared distance from a position to the closest point inside a node
+	 */
+	FORCEINLINE float GetDistSquaredToNode(FVector2D Position, const FNodeRange &Node) const
+	{
+		FVector2D nodeMin, nodeMax;
+		GetNodeBounds(Node, nodeMin, nodeMax);
+
+		float dx = FMath::Max3(nodeMin.X - Position.X, 0.f, Position.X - nodeMax.X);
+		float dy = FMath::Max3(nodeMin.Y - Position.Y, 0.f, Position.Y - nodeMax.Y);
+		return dx * dx + dy * dy;
+	}
+
+	/**
+	 * Visits all actors in a node that lie inside a rectangle
+	 *
+	 * @returns False if the visitor stopped the query early
+	 */
+	template<typename VisitorType>
+	bool QueryRectRecursive(const FNodeRange &Node, const FVector2D &Min, const FVector2D &Max, VisitorType &Visitor) const
+	{
+		FVector2D nodeMin, nodeMax;
+		GetNodeBounds(Node, nodeMin, nodeMax);
+		if (nodeMin.X > Max.X || nodeMax.X < Min.X || nodeMin.Y > Max.Y || nodeMax.Y < Min.Y)
+			return true;
+
+		// Skip the per actor test when the whole node is inside the rectangle
+		bool bContained = Min.X <= nodeMin.X && Min.Y <= nodeMin.Y && nodeMax.X <= Max.X && nodeMax.Y <= Max.Y;
+		if (bContained || IsLeaf(Node))
+		{
+			for (int32 i = Node.Begin; i < Node.End; i++)
+			{
+				const FVector2D &pos = positions[i];
+				if (bContained || (pos.X >= Min.X && pos.X <= Max.X && pos.Y >= Min.Y && pos.Y <= Max.Y))
+				{
+					if (!Visitor(data[i], pos))
+						return false;
+				}
+			}
+			return true;
+		}
+
+		FNodeRange children[4];
+		int32 numChildren = SplitNode(Node, children);
+		for (int32 i = 0; i < numChildren; i++)
+		{
+			if (!QueryRectRecursive(children[i], Min, Max, Visitor))
+				return false;
+		}
+		return true;
+	}
+
+	/**
+	 * Visits all actors in a node that lie within a radius of a position
+	 *
+	 * @returns False if the visitor stopped the query early
+	 */
+	template<typename VisitorType>
+	bool QueryRadiusRecursive(const FNodeRange &Node, const FVector2D &Center, float RadiusSquared, VisitorType &Visitor) const
+	{
+		FVector2D nodeMin, nodeMax;
+		GetNodeBounds(Node, nodeMin, nodeMax);
+
+		float nearX = FMath::Max3(nodeMin.X - Center.X, 0.f, Center.X - nodeMax.X);
+		float nearY = FMath::Max3(nodeMin.Y - Center.Y, 0.f, Center.Y - nodeMax.Y);
+		if (nearX * nearX + nearY * nearY > RadiusSquared)
+			return true;
+
+		// Skip the per actor test when the whole node is inside the circle
+		float farX = FMath::Max(FMath::Abs(Center.X - nodeMin.X), FMath::Abs(Center.X - nodeMax.X));
+		float farY = FMath::Max(FMath::Abs(Center.Y - nodeMin.Y), FMath::Abs(Center.Y - nodeMax.Y));
+		bool bContained = farX * farX + farY * farY <= RadiusSquared;
+		if (bContained || IsLeaf(Node))
+		{
+			for (int32 i = Node.Begin; i < Node.End; i++)
+			{
+				const FVector2D &pos = positions[i];
+				if (bContained || FVector2D::DistSquared(Center, pos) <= RadiusSquared)
+				{
+					if (!Visitor(data[i], pos))
+						return false;
+				}
+			}
+			return true;
+		}
+
+		FNodeRange children[4];
+		int32 numChildren = SplitNode(Node, children);
+		for (int32 i = 0; i < numChildren; i++)
+		{
+			if (!QueryRadiusRecursive(children[i], Center, RadiusSquared, Visitor))
+				return false;
+		}
+		return true;
+	}
+
+private:
+	/** Actors in the tree sorted by Morton code */
+	TArray<class AActor*> data;
+
+	/** Cached 2D position of each Actor in data, stored at the same index */
+	TArray<FVector2D> positions;
+
+	/** Morton code of each Actor in data, stored at the same index */
+	TArray<uint32> codes;
+
+	/** Rules deciding which nodes are scanned directly instead of being split */
+	FSplitPolicy policy;
+
+	/** Level nodes stop splitting at, worked out from the policy and the size of the bounds */
+	int32 maxSplitLevel;
+
+	/** Boundary the quantization grid covers */
+	FVector2D minBounds;
+	FVector2D maxBounds;
+
+	/** World size of a single quantization cell */
+	FVector2D cellSize;
+};
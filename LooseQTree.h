@@ -0,0 +1,632 @@
+// Copyright (c) 2018 Ryan Dougherty. All rights reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "NodePool.h"
+#include "SpatialTree.h"
+#include "Runtime/Engine/Classes/GameFramework/Actor.h"
+
+/**
+ * LooseQTree is a loose Quad Tree of Actors with extents. Every entry keeps a 2D bounding box and is stored in the
+ * deepest node whose loose bounds, the node's cell grown by the looseness factor, can hold a box of its size. The
+ * node is picked only from the center and size of the box, so entries never straddle nodes and never need to be
+ * split, and an overlap query only opens nodes whose loose bounds touch the query region.
+ *
+ * Boxes centered outside the tree's boundary are kept in the root, which is always searched.
+ */
+class LooseQTree
+{
+public:
+	/**
+	 * Default constructor for an empty tree with no defined boundaries. Build fits the boundary around its Actors
+	 *
+	 * @param InLooseness How far each node's loose bounds reach, as a multiple of its cell size. At least 1
+	 * @param InMaxDepth Deepest level entries are placed at, where the root is level 0
+	 */
+	LooseQTree(float InLooseness = 2.f, int32 InMaxDepth = 8) : root(FVector2D::ZeroVector, FVector2D::ZeroVector, NULL), looseness(FMath::Max(InLooseness, 1.f)), maxDepth(FMath::Max(InMaxDepth, 0)), firstFreeEntry(INDEX_NONE), nextSerial(1)
+	{
+	}
+
+	/**
+	 * Constructor for an empty tree specifying boundaries
+	 *
+	 * @param StartBounds Smallest corner of the boundary
+	 * @param EndBounds Largest corner of the boundary
+	 * @param InLooseness How far each node's loose bounds reach, as a multiple of its cell size. At least 1
+	 * @param InMaxDepth Deepest level entries are placed at, where the root is level 0
+	 */
+	LooseQTree(FVector2D StartBounds, FVector2D EndBounds, float InLooseness = 2.f, int32 InMaxDepth = 8) : root((StartBounds + EndBounds) / 2, (EndBounds - StartBounds) / 2, NULL), looseness(FMath::Max(InLooseness, 1.f)), maxDepth(FMath::Max(InMaxDepth, 0)), firstFreeEntry(INDEX_NONE), nextSerial(1)
+	{
+	}
+
+	LooseQTree(const LooseQTree&) = delete;
+	LooseQTree& operator=(const LooseQTree&) = delete;
+
+	/**
+	 * Default destructor
+	 */
+	~LooseQTree()
+	{
+		FreeChildren(&root);
+	}
+
+	/**
+	 * Adds an actor to the tree with the 2D bounds of all of its components
+	 *
+	 * @param Act Actor to be added into the tree
+	 * @returns Handle to the actor's entry
+	 */
+	FORCEINLINE FSpatialTreeHandle Add(AActor *Act)
+	{
+		return Add(Act, GetActorBox(Act));
+	}
+
+	/**
+	 * Adds an actor to the tree with an explicit bounding box. Adding an actor already in the tree moves it to the
+	 * new box and keeps its handle.
+	 *
+	 * @param Act Actor to be added into the tree
+	 * @param Box 2D bounds to index the actor with
+	 * @returns Handle to the actor's entry
+	 */
+	FSpatialTreeHandle Add(AActor *Act, const FBox2D &Box)
+	{
+		int32 *existingEntry = actorEntries.Find(Act);
+		if (existingEntry != NULL)
+		{
+			MoveEntry(*existingEntry, Box);
+			return MakeHandle(*existingEntry);
+		}
+
+		int32 entryIndex = AllocateEntry(Act);
+		AddToNode(FindNodeFor(Box), entryIndex, Box);
+		return MakeHandle(entryIndex);
+	}
+
+	/**
+	 * Replaces everything in the tree with a list of Actors, fitting the boundary around all of their bounds
+	 *
+	 * @param Actors List of all actors to store in the tree
+	 */
+	void Build(const TArray<AActor*> &Actors)
+	{
+		Empty();
+
+		TArray<FBox2D> boxes;
+		boxes.Reserve(Actors.Num());
+		FBox2D allBounds(ForceInit);
+		for (AActor *act : Actors)
+		{
+			boxes.Add(GetActorBox(act));
+			allBounds += boxes.Last();
+		}
+
+		if (allBounds.bIsValid)
+		{
+			root.Center = allBounds.GetCenter();
+			root.HalfSize = allBounds.GetExtent();
+		}
+
+		for (int32 i = 0; i < Actors.Num(); i++)
+			Add(Actors[i], boxes[i]);
+	}
+
+	/**
+	 * Removes the entry a handle refers to
+	 *
+	 * @param Handle Handle returned when the actor was added
+	 * @returns True if the entry still existed and was removed
+	 */
+	FORCEINLINE bool Remove(FSpatialTreeHandle Handle)
+	{
+		if (!IsValid(Handle))
+			return false;
+
+		RemoveEntry(Handle.Index);
+		return true;
+	}
+
+	/**
+	 * Removes an actor from the tree
+	 *
+	 * @param Act Actor to remove from the tree
+	 * @returns True if the actor was found and removed
+	 */
+	FORCEINLINE bool Remove(AActor *Act)
+	{
+		int32 *entryIndex = actorEntries.Find(Act);
+		if (entryIndex == NULL)
+			return false;
+
+		RemoveEntry(*entryIndex);
+		return true;
+	}
+
+	/**
+	 * Moves an actor already in the tree to the current bounds of its components
+	 *
+	 * @param Act Actor to move in the tree
+	 * @returns True if the actor is in the tree
+	 */
+	FORCEINLINE bool Update(AActor *Act)
+	{
+		return Update(Act, GetActorBox(Act));
+	}
+
+	/**
+	 * Moves an actor already in the tree to a new bounding box. The actor stays in its node when the new box still
+	 * belongs there.
+	 *
+	 * @param Act Actor to move in the tree
+	 * @param Box New 2D bounds of the actor
+	 * @returns True if the actor is in the tree
+	 */
+	bool Update(AActor *Act, const FBox2D &Box)
+	{
+		int32 *entryIndex = actorEntries.Find(Act);
+		if (entryIndex == NULL)
+			return false;
+
+		MoveEntry(*entryIndex, Box);
+		return true;
+	}
+
+	/**
+	 * Visits every actor whose bounding box overlaps a region, edges included. Nodes whose loose bounds miss the
+	 * region are skipped along with everything below them.
+	 *
+	 * @param Region Area to search
+	 * @param Visitor Called as bool(AActor*, const FBox2D&) for each actor found, return false to stop the query
+	 * @returns False if the visitor stopped the query early
+	 */
+	template<typename VisitorType>
+	FORCEINLINE bool QueryOverlap(const FBox2D &Region, VisitorType &&Visitor) const
+	{
+		return QueryOverlapRecursive(&root, Region, Visitor);
+	}
+
+	/**
+	 * Gets whether any actor's bounding box overlaps a region
+	 *
+	 * @param Region Area to test
+	 * @returns True if at least one box overlaps the region
+	 */
+	FORCEINLINE bool AnyOverlap(const FBox2D &Region) const
+	{
+		return !QueryOverlap(Region, [](AActor*, const FBox2D&) { return false; });
+	}
+
+	/**
+	 * Gets whether any actor's bounding box contains a position, edges included
+	 *
+	 * @param Position Position to test
+	 * @returns True if at least one box contains the position
+	 */
+	FORCEINLINE bool AnyContains(FVector2D Position) const
+	{
+		return AnyOverlap(FBox2D(Position, Position));
+	}
+
+	/**
+	 * Gets whether an actor is stored in the tree
+	 */
+	FORCEINLINE bool Contains(AActor *Act) const
+	{
+		return actorEntries.Contains(Act);
+	}
+
+	/**
+	 * Gets whether a handle still refers to an entry in the tree
+	 */
+	FORCEINLINE bool IsValid(FSpatialTreeHandle Handle) const
+	{
+		return entries.IsValidIndex(Handle.Index) && entries[Handle.Index].Serial == Handle.Serial;
+	}
+
+	/**
+	 * Gets the actor a handle refers to
+	 *
+	 * @returns The actor, or NULL if the entry has been removed
+	 */
+	FORCEINLINE AActor * GetActor(FSpatialTreeHandle Handle) const
+	{
+		return IsValid(Handle) ? entries[Handle.Index].Actor : NULL;
+	}
+
+	/**
+	 * Gets the number of actors in the tree
+	 */
+	FORCEINLINE int32 Num() const
+	{
+		return actorEntries.Num();
+	}
+
+	/**
+	 * Returns an array of all Actors in the tree
+	 */
+	TArray<AActor*> GetAllActors() const
+	{
+		TArray<AActor*> actors;
+		actors.Reserve(Num());
+		QueryAll(&root, actors);
+		return actors;
+	}
+
+	/**
+	 * Removes every actor from the tree and returns every node below the root to the pool
+	 */
+	void Empty()
+	{
+		FreeChildren(&root);
+		pool.Reset();
+		root.Data.Empty();
+		root.Boxes.Empty();
+		root.EntryIndices.Empty();
+		entries.Reset();
+		firstFreeEntry = INDEX_NONE;
+		actorEntries.Reset();
+	}
+
+	/**
+	 * Sets the boundary of the tree and places every Actor in it again. Handles stay valid
+	 *
+	 * @param Min Smallest corner of the boundary
+	 * @param Max Largest corner of the boundary
+	 */
+	void SetBounds(FVector2D Min, FVector2D Max)
+	{
+		TArray<int32> allEntries;
+		TArray<FBox2D> allBoxes;
+		TraverseAndPop(&root, allEntries, allBoxes);
+		FreeChildren(&root);
+
+		root.Center = (Min + Max) / 2;
+		root.HalfSize = (Max - Min) / 2;
+		for (int32 i = 0; i < allEntries.Num(); i++)
+			AddToNode(FindNodeFor(allBoxes[i]), allEntries[i], allBoxes[i]);
+	}
+
+	/**
+	 * Gets the 2D bounding box of all of an actor's components
+	 *
+	 * @param Act Actor to measure
+	 * @returns The actor's bounds projected onto the X,Y plane
+	 */
+	static FBox2D GetActorBox(const AActor *Act)
+	{
+		FVector origin, extent;
+		Act->GetActorBounds(false, origin, extent);
+		return FBox2D(FVector2D(origin.X - extent.X, origin.Y - extent.Y), FVector2D(origin.X + extent.X, origin.Y + extent.Y));
+	}
+
+private:
+	/** Node of the tree, covering a cell while holding boxes that reach out to its loose bounds */
+	struct FNode
+	{
+		FNode(FVector2D InCenter, FVector2D InHalfSize, FNode *InParent) : Center(InCenter), HalfSize(InHalfSize), Parent(InParent), Depth(InParent != NULL ? InParent->Depth + 1 : 0)
+		{
+			for (int32 i = 0; i < 4; i++)
+				Children[i] = NULL;
+		}
+
+		/** Center of the node's cell */
+		FVector2D Center;
+
+		/** Half the size of the node's cell along each axis */
+		FVector2D HalfSize;
+
+		/** Node this node is a child of, or NULL for the root */
+		FNode *Parent;
+
+		/** Level of the node, where the root is level 0 */
+		int32 Depth;
+
+		/** Child nodes, indexed like the Quadrant enum */
+		FNode *Children[4];
+
+		/** Actors stored in this node */
+		TArray<AActor*> Data;
+
+		/** Bounding box of each Actor in Data, stored at the same index */
+		TArray<FBox2D> Boxes;
+
+		/** Entry of each Actor in Data, stored at the same index */
+		TArray<int32> EntryIndices;
+	};
+
+	/** Where one actor is stored in the tree. Free entries keep the index of the next free entry in Slot */
+	struct FEntry
+	{
+		AActor *Actor;
+		FNode *Node;
+		int32 Slot;
+		uint32 Serial;
+	};
+
+	/**
+	 * Finds the node a box belongs in, creating nodes down to it as needed. That is the deepest node whose cell holds
+	 * the center of the box and whose loose bounds are still big enough to hold all of it.
+	 *
+	 * @param Box Box to place
+	 * @returns The node to store the box in
+	 */
+	FNode * FindNodeFor(const FBox2D &Box)
+	{
+		FVector2D center = Box.GetCenter();
+		FVector2D extent = Box.GetExtent();
+
+		// Anything centered outside the boundary can only go in the root
+		if (FMath::Abs(center.X - root.Center.X) > root.HalfSize.X || FMath::Abs(center.Y - root.Center.Y) > root.HalfSize.Y)
+			return &root;
+
+		FNode *node = &root;
+		while (node->Depth < maxDepth)
+		{
+			// A child's loose bounds reach (looseness - 1) of its half size past its cell on every side, so any box
+			// centered in the cell fits as long as its extent does
+			FVector2D childReach = node->HalfSize * (0.5f * (looseness - 1.f));
+			if (extent.X > childReach.X || extent.Y > childReach.Y)
+				break;
+
+			int32 index = (center.X > node->Center.X ? 1 : 0) | (center.Y > node->Center.Y ? 2 : 0);
+			if (node->Children[index] == NULL)
+			{
+				FVector2D childHalf = node->HalfSize / 2;
+				FVector2D childCenter(node->Center.X + ((index & 1) ? childHalf.X : -childHalf.X), node->Center.Y + ((index & 2) ? childHalf.Y : -childHalf.Y));
+				node->Children[index] = pool.Allocate(childCenter, childHalf, node);
+			}
+			node = node->Children[index];
+		}
+		return node;
+	}
+
+	/**
+	 * Stores an entry in a node and points the entry at it
+	 */
+	void AddToNode(FNode *Node, int32 EntryIndex, const FBox2D &Box)
+	{
+		FEntry &entry = entries[EntryIndex];
+		entry.Node = Node;
+		entry.Slot = Node->Data.Num();
+
+		Node->Data.Add(entry.Actor);
+		Node->Boxes.Add(Box);
+		Node->EntryIndices.Add(EntryIndex);
+	}
+
+	/**
+	 * Drops an entry from its node. The order of a node's data is not meaningful so the last entry fills the gap
+	 */
+	void RemoveFromNode(FNode *Node, int32 Slot)
+	{
+		Node->Data.RemoveAtSwap(Slot);
+		Node->Boxes.RemoveAtSwap(Slot);
+		Node->EntryIndices.RemoveAtSwap(Slot);
+
+		if (Slot < Node->EntryIndices.Num())
+			entries[Node->EntryIndices[Slot]].Slot = Slot;
+	}
+
+	/**
+	 * Frees a node if it is left without data or children, then keeps going up while each parent is left empty too
+	 */
+	void CollapseUpwards(FNode *Node)
+	{
+		while (Node->Parent != NULL && Node->Data.Num() == 0 && !HasChildren(Node))
+		{
+			FNode *parent = Node->Parent;
+			for (FNode *&child : parent->Children)
+			{
+				if (child == Node)
+					child = NULL;
+			}
+
+			pool.Free(Node);
+			Node = parent;
+		}
+	}
+
+	/**
+	 * Moves an entry to a new box, leaving it in its node when the box still belongs there
+	 */
+	void MoveEntry(int32 EntryIndex, const FBox2D &Box)
+	{
+		FNode *oldNode = entries[EntryIndex].Node;
+		FNode *newNode = FindNodeFor(Box);
+		if (newNode == oldNode)
+		{
+			oldNode->Boxes[entries[EntryIndex].Slot] = Box;
+			return;
+		}
+
+		RemoveFromNode(oldNode, entries[EntryIndex].Slot);
+		AddToNode(newNode, EntryIndex, Box);
+		CollapseUpwards(oldNode);
+	}
+
+	/**
+	 * Removes an entry from its node, frees it and collapses the nodes around it
+	 */
+	void RemoveEntry(int32 EntryIndex)
+	{
+		FNode *node = entries[EntryIndex].Node;
+		RemoveFromNode(node, entries[EntryIndex].Slot);
+		FreeEntry(EntryIndex);
+		CollapseUpwards(node);
+	}
+
+	/**
+	 * Creates a new entry for an actor, reusing a freed one if there is any
+	 */
+	int32 AllocateEntry(AActor *Act)
+	{
+		int32 entryIndex = firstFreeEntry;
+		if (entryIndex != INDEX_NONE)
+			firstFreeEntry = entries[entryIndex].Slot;
+		else
+			entryIndex = entries.AddUninitialized();
+
+		FEntry &entry = entries[entryIndex];
+		entry.Actor = Act;
+		entry.Node = NULL;
+		entry.Slot = INDEX_NONE;
+		entry.Serial = nextSerial;
+
+		if (++nextSerial == 0)
+			nextSerial = 1;
+
+		actorEntries.Add(Act, entryIndex);
+		return entryIndex;
+	}
+
+	/**
+	 * Returns an entry to the free list, invalidating its handles
+	 */
+	void FreeEntry(int32 EntryIndex)
+	{
+		FEntry &entry = entries[EntryIndex];
+		actorEntries.Remove(entry.Actor);
+
+		entry.Actor = NULL;
+		entry.Node = NULL;
+		entry.Serial = 0;
+		entry.Slot = firstFreeEntry;
+		firstFreeEntry = EntryIndex;
+	}
+
+	/**
+	 * Makes a handle for an entry
+	 */
+	FORCEINLINE FSpatialTreeHandle MakeHandle(int32 EntryIndex) const
+	{
+		FSpatialTreeHandle handle;
+		handle.Index = EntryIndex;
+		handle.Serial = entries[EntryIndex].Serial;
+		return handle;
+	}
+
+	/**
+	 * Gets whether a node has any children
+	 */
+	static FORCEINLINE bool HasChildren(const FNode *Node)
+	{
+		return Node->Children[0] != NULL || Node->Children[1] != NULL || Node->Children[2] != NULL || Node->Children[3] != NULL;
+	}
+
+	/**
+	 * Returns every node below a node to the pool
+	 */
+	void FreeChildren(FNode *Node)
+	{
+		for (FNode *&child : Node->Children)
+		{
+			if (child != NULL)
+			{
+				FreeChildren(child);
+				pool.Free(child);
+				child = NULL;
+			}
+		}
+	}
+
+	/**
+	 * Gets whether two boxes overlap, edges included
+	 */
+	static FORCEINLINE bool Overlaps(const FBox2D &A, const FBox2D &B)
+	{
+		return A.Min.X <= B.Max.X && B.Min.X <= A.Max.X && A.Min.Y <= B.Max.Y && B.Min.Y <= A.Max.Y;
+	}
+
+	/**
+	 * Gets whether a node's loose bounds overlap a region. The root holds boxes from anywhere, so it always does
+	 */
+	FORCEINLINE bool LooseBoundsOverlap(const FNode *Node, const FBox2D &Region) const
+	{
+		if (Node->Parent == NULL)
+			return true;
+
+		FVector2D looseHalf = Node->HalfSize * looseness;
+		return Overlaps(FBox2D(Node->Center - looseHalf, Node->Center + looseHalf), Region);
+	}
+
+	/**
+	 * Visits every actor in a node and below it whose box overlaps a region
+	 *
+	 * @returns False if the visitor stopped the query early
+	 */
+	template<typename VisitorType>
+	bool QueryOverlapRecursive(const FNode *Node, const FBox2D &Region, VisitorType &Visitor) const
+	{
+		for (int32 i = 0; i < Node->Boxes.Num(); i++)
+		{
+			if (Overlaps(Node->Boxes[i], Region) && !Visitor(Node->Data[i], Node->Boxes[i]))
+				return false;
+		}
+
+		for (const FNode *child : Node->Children)
+		{
+			if (child != NULL && LooseBoundsOverlap(child, Region))
+			{
+				if (!QueryOverlapRecursive(child, Region, Visitor))
+					return false;
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * Appends every actor in a node and below it
+	 */
+	void QueryAll(const FNode *Node, TArray<AActor*> &OutActors) const
+	{
+		OutActors.Append(Node->Data);
+		for (const FNode *child : Node->Children)
+		{
+			if (child != NULL)
+				QueryAll(child, OutActors);
+		}
+	}
+
+	/**
+	 * Pops every entry out of a node and below it
+	 */
+	void TraverseAndPop(FNode *Node, TArray<int32> &OutEntries, TArray<FBox2D> &OutBoxes)
+	{
+		OutEntries.Append(Node->EntryIndices);
+		OutBoxes.Append(Node->Boxes);
+		Node->Data.Empty();
+		Node->Boxes.Empty();
+		Node->EntryIndices.Empty();
+
+		for (FNode *child : Node->Children)
+		{
+			if (child != NULL)
+				TraverseAndPop(child, OutEntries, OutBoxes);
+		}
+	}
+
+	/** Pool every node below the root is allocated from */
+	TNodePool<FNode> pool;
+
+	/** Root node, covering the boundary of the tree */
+	FNode root;
+
+	/** How far each node's loose bounds reach, as a multiple of its cell size */
+	float looseness;
+
+	/** Deepest level entries are placed at */
+	int32 maxDepth;
+
+	/** Every entry handed out by the tree, indexed by handle */
+	TArray<FEntry> entries;
+
+	/** Most recently freed entry */
+	int32 firstFreeEntry;
+
+	/** Serial number given to the next entry, never zero */
+	uint32 nextSerial;
+
+	/** Entry of each Actor in the tree */
+	TMap<AActor*, int32> actorEntries;
+};
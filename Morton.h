@@ -0,0 +1,139 @@
+// Copyright (c) 2018 Ryan Dougherty. All rights reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * FMorton builds Morton (Z-order) codes by interleaving the bits of quantized coordinates, so that points which are
+ * close in space end up close together once sorted by their code.
+ * Bit 0 of every 2 bit group holds X and bit 1 holds Y, which matches the order of the Quadrant enum. 3D codes use 3
+ * bit groups the same way, matching the order of the Octant enum.
+ */
+struct FMorton
+{
+	/** Number of bits kept for each axis of a 2D code */
+	static const int32 BitsPerAxis2D = 16;
+
+	/** Number of bits kept for each axis of a 3D code */
+	static const int32 BitsPerAxis3D = 10;
+
+	/**
+	 * Interleaves two 16 bit cell coordinates into a 32 bit Morton code
+	 *
+	 * @param X Cell coordinate along X
+	 * @param Y Cell coordinate along Y
+	 * @returns The Morton code of the cell
+	 */
+	static FORCEINLINE uint32 Encode2D(uint32 X, uint32 Y)
+	{
+		return SpreadBits2D(X) | (SpreadBits2D(Y) << 1);
+	}
+
+	/**
+	 * Interleaves three 10 bit cell coordinates into a 30 bit Morton code
+	 *
+	 * @param X Cell coordinate along X
+	 * @param Y Cell coordinate along Y
+	 * @param Z Cell coordinate along Z
+	 * @returns The Morton code of the cell
+	 */
+	static FORCEINLINE uint32 Encode3D(uint32 X, uint32 Y, uint32 Z)
+	{
+		return SpreadBits3D(X) | (SpreadBits3D(Y) << 1) | (SpreadBits3D(Z) << 2);
+	}
+
+	/**
+	 * Splits a 32 bit Morton code back into its two cell coordinates
+	 *
+	 * @param Code Morton code to split
+	 * @param OutX Cell coordinate along X
+	 * @param OutY Cell coordinate along Y
+	 */
+	static FORCEINLINE void Decode2D(uint32 Code, uint32 &OutX, uint32 &OutY)
+	{
+		OutX = CompactBits2D(Code);
+		OutY = CompactBits2D(Code >> 1);
+	}
+
+	/**
+	 * Sorts a list of codes with an LSD radix sort, one byte per pass, and returns the order they sort into.
+	 * Passes where every code shares the same byte are skipped.
+	 *
+	 * @param Codes Codes to sort, left untouched
+	 * @param OutOrder Filled with the indices of Codes in ascending code order
+	 */
+	static void RadixSort(const TArray<uint32> &Codes, TArray<int32> &OutOrder)
+	{
+		int32 num = Codes.Num();
+		TArray<int32> scratch;
+		OutOrder.SetNumUninitialized(num);
+		scratch.SetNumUninitialized(num);
+
+		for (int32 i = 0; i < num; i++)
+			OutOrder[i] = i;
+
+		if (num == 0)
+			return;
+
+		for (int32 shift = 0; shift < 32; shift += 8)
+		{
+			int32 counts[256] = { 0 };
+			for (int32 i = 0; i < num; i++)
+				counts[(Codes[i] >> shift) & 0xFF]++;
+
+			// Every code has the same byte here so this pass would not move anything
+			if (counts[(Codes[0] >> shift) & 0xFF] == num)
+				continue;
+
+			int32 offset = 0;
+			for (int32 bucket = 0; bucket < 256; bucket++)
+			{
+				int32 count = counts[bucket];
+				counts[bucket] = offset;
+				offset += count;
+			}
+
+			for (int32 i = 0; i < num; i++)
+			{
+				int32 index = OutOrder[i];
+				scratch[counts[(Codes[index] >> shift) & 0xFF]++] = index;
+			}
+			Swap(OutOrder, scratch);
+		}
+	}
+
+private:
+	/** Spreads the low 16 bits of a value out so there is a zero bit between each of them */
+	static FORCEINLINE uint32 SpreadBits2D(uint32 Value)
+	{
+		Value &= 0x0000FFFF;
+		Value = (Value | (Value << 8)) & 0x00FF00FF;
+		Value = (Value | (Value << 4)) & 0x0F0F0F0F;
+		Value = (Value | (Value << 2)) & 0x33333333;
+		Value = (Value | (Value << 1)) & 0x55555555;
+		return Value;
+	}
+
+	/** Spreads the low 10 bits of a value out so there are two zero bits between each of them */
+	static FORCEINLINE uint32 SpreadBits3D(uint32 Value)
+	{
+		Value &= 0x000003FF;
+		Value = (Value | (Value << 16)) & 0x030000FF;
+		Value = (Value | (Value << 8)) & 0x0300F00F;
+		Value = (Value | (Value << 4)) & 0x030C30C3;
+		Value = (Value | (Value << 2)) & 0x09249249;
+		return Value;
+	}
+
+	/** Gathers every other bit of a value back into the low 16 bits */
+	static FORCEINLINE uint32 CompactBits2D(uint32 Value)
+	{
+		Value &= 0x55555555;
+		Value = (Value | (Value >> 1)) & 0x33333333;
+		Value = (Value | (Value >> 2)) & 0x0F0F0F0F;
+		Value = (Value | (Value >> 4)) & 0x00FF00FF;
+		Value = (Value | (Value >> 8)) & 0x0000FFFF;
+		return Value;
+	}
+};
@@ -0,0 +1,182 @@
+// Copyright (c) 2018 Ryan Dougherty. All rights reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * TNodePool hands out tree nodes from contiguous slabs of memory and recycles freed nodes through a free list.
+ * Nodes created by the same pool sit next to each other in memory, only one heap allocation is made per slab
+ * and every slab is released together when the pool is destroyed.
+ */
+template<typename NodeType, int32 NodesPerSlab = 64>
+class TNodePool
+{
+public:
+	/**
+	 * Default constructor for an empty pool. No memory is allocated until the first node is requested
+	 */
+	TNodePool() : freeList(NULL), currentSlab(INDEX_NONE), nextInSlab(NodesPerSlab), numAllocated(0)
+	{
+	}
+
+	/**
+	 * Releases every slab owned by the pool. All nodes must already have been freed or destroyed
+	 */
+	~TNodePool()
+	{
+		for (FSlot *slab : slabs)
+			FMemory::Free(slab);
+	}
+
+	TNodePool(const TNodePool&) = delete;
+	TNodePool& operator=(const TNodePool&) = delete;
+
+	/**
+	 * Constructs a new node inside the pool
+	 *
+	 * @param Args Arguments forwarded to the node's constructor
+	 * @returns The newly constructed node
+	 */
+	template<typename... ArgTypes>
+	FORCEINLINE NodeType * Allocate(ArgTypes&&... Args)
+	{
+		void *memory;
+
+		// Reuse a freed node first so recycled memory stays warm
+		if (freeList != NULL)
+		{
+			memory = freeList;
+			freeList = freeList->Next;
+		}
+		else
+		{
+			if (nextInSlab == NodesPerSlab)
+			{
+				// Move on to the next slab, only going to the heap when every slab is in use
+				currentSlab++;
+				if (currentSlab == slabs.Num())
+					slabs.Add((FSlot*)FMemory::Malloc(sizeof(FSlot) * NodesPerSlab, alignof(FSlot)));
+				nextInSlab = 0;
+			}
+			memory = &slabs[currentSlab][nextInSlab++];
+		}
+
+		numAllocated++;
+		return new (memory) NodeType(Forward<ArgTypes>(Args)...);
+	}
+
+	/**
+	 * Destroys a node and returns its memory to the pool
+	 *
+	 * @param Node Node previously created by this pool
+	 */
+	FORCEINLINE void Free(NodeType *Node)
+	{
+		Node->~NodeType();
+
+		FSlot *slot = reinterpret_cast<FSlot*>(Node);
+		slot->Next = freeList;
+		freeList = slot;
+		numAllocated--;
+	}
+
+	/**
+	 * Forgets every node handed out by the pool while keeping its slabs for reuse. Nodes are not destroyed, so this
+	 * must only be called once every node has been destroyed or has nothing left to release.
+	 */
+	FORCEINLINE void Reset()
+	{
+		freeList = NULL;
+		currentSlab = slabs.Num() > 0 ? 0 : INDEX_NONE;
+		nextInSlab = slabs.Num() > 0 ? 0 : NodesPerSlab;
+		numAllocated = 0;
+	}
+
+	/**
+	 * Takes over every slab of another pool, so nodes it handed out can be freed through this pool and its memory is
+	 * released with this pool. Slots the other pool never handed out are added to this pool's free list. The other
+	 * pool is left empty.
+	 *
+	 * @param Other Pool to take the slabs of
+	 */
+	void Absorb(TNodePool &Other)
+	{
+		if (Other.slabs.Num() == 0)
+			return;
+
+		// Give back every slot the other pool never carved out, then every slot it freed
+		for (int32 slab = FMath::Max(Other.currentSlab, 0); slab < Other.slabs.Num(); slab++)
+		{
+			int32 firstUnused = slab == Other.currentSlab ? Other.nextInSlab : 0;
+			for (int32 i = firstUnused; i < NodesPerSlab; i++)
+				PushFree(&Other.slabs[slab][i]);
+		}
+
+		while (Other.freeList != NULL)
+		{
+			FSlot *slot = Other.freeList;
+			Other.freeList = slot->Next;
+			PushFree(slot);
+		}
+
+		// Absorbed slabs go in front of this pool's slabs so they are never carved from again until Reset
+		int32 numAbsorbed = Other.slabs.Num();
+		slabs.Insert(Other.slabs, 0);
+		if (currentSlab == INDEX_NONE)
+		{
+			currentSlab = numAbsorbed - 1;
+			nextInSlab = NodesPerSlab;
+		}
+		else
+		{
+			currentSlab += numAbsorbed;
+		}
+		numAllocated += Other.numAllocated;
+
+		Other.slabs.Empty();
+		Other.currentSlab = INDEX_NONE;
+		Other.nextInSlab = NodesPerSlab;
+		Other.numAllocated = 0;
+	}
+
+	/**
+	 * Gets the number of nodes currently handed out by the pool
+	 *
+	 * @returns Number of live nodes
+	 */
+	FORCEINLINE int32 Num() const
+	{
+		return numAllocated;
+	}
+
+private:
+	/** Storage for one node, reused as a free list link while the node is not in use */
+	union FSlot
+	{
+		FSlot *Next;
+		TTypeCompatibleBytes<NodeType> Node;
+	};
+
+	/** Adds an unused slot to the free list */
+	FORCEINLINE void PushFree(FSlot *Slot)
+	{
+		Slot->Next = freeList;
+		freeList = Slot;
+	}
+
+	/** Every slab of NodesPerSlab slots owned by the pool */
+	TArray<FSlot*> slabs;
+
+	/** Most recently freed slot */
+	FSlot *freeList;
+
+	/** Slab new nodes are currently carved from */
+	int32 currentSlab;
+
+	/** Next unused slot in the current slab */
+	int32 nextInSlab;
+
+	/** Number of live nodes */
+	int32 numAllocated;
+};
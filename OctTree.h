@@ -2,11 +2,12 @@
 
 #pragma once
 
-#include "CoreMinimal.h"
-#include "Runtime/Engine/Classes/GameFramework/Actor.h"
+#include "SpatialTree.h"
 
 /**
- * Octant represents an area of space within a 3D X, Y, Z plane
+ * Octant represents an area of space within a 3D X, Y, Z plane. Each value is the index of the matching child of an
+ * OctTree node. Right octants have bit 0 set, bottom octants bit 1 and front octants bit 2, where right, bottom and
+ * front are the larger X, Y and Z side of a node's midpoint.
  */
 enum Octant
 {
@@ -20,49 +21,12 @@ enum Octant
 	BottomRightFront
 };
 
-class OctTree
-{
-public:
-	/**
-	 * Default constructor for empty OctTree with no defined boundaries
-	 */
-	OctTree() : data()
-	{
-		this->topLeftFrontBounds = FVector::ZeroVector;
-		this->bottomRightBackBounds = FVector::ZeroVector;
-
-		for (int i = 0; i < 8; i++)
-			trees[i] = NULL;
-	}
-
-private:
-	/** Bucket size for this tree */
-	static const int bucket_size = 3;
-
-	/** Boundary points for the node */
-	FVector topLeftFrontBounds;
-	FVector bottomRightBackBounds;
-
-	/** Data stored in this QTree */
-	TArray<class AActor*> data;
-
-	/** Child nodes accessible by array indexing or direct access */
-	union
-	{
-		struct
-		{
-			OctTree *topLeftBackTree;
-			OctTree *topRightBackTree;
-			OctTree *bottomLeftBackTree;
-			OctTree *bottomRightBackTree;
-
-			OctTree *topLeftFrontTree;
-			OctTree *topRightFrontTree;
-			OctTree *bottomLeftFrontTree;
-			OctTree *bottomRightFrontTree;
-		};
-
-		OctTree *trees[8];
-	};
+/**
+ * OctTree is an Oct Tree of Actors, the 3D version of TSpatialTree
+ */
+typedef TSpatialTree<3> OctTree;
 
-};
\ No newline at end of file
+/**
+ * FOctTreeHandle identifies one entry in an OctTree
+ */
+typedef FSpatialTreeHandle FOctTreeHandle;
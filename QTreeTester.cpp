@@ -2,8 +2,17 @@
 
 #include "QTreeTester.h"
 #include "QTree.h"
+#include "OctTree.h"
+#include "LinearQTree.h"
+#include "SpatialSnapshot.h"
 #include "Helpers.h"
 #include "Runtime/Engine/Classes/GameFramework/Actor.h"
+#include "Runtime/Engine/Classes/Engine/World.h"
+#include "Runtime/Engine/Classes/Engine/TargetPoint.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "Async/ParallelFor.h"
+#include <atomic>
 
 
 // Sets default values
@@ -21,6 +30,9 @@ void AQTreeTester::BeginPlay()
 	Super::BeginPlay();
 
 	TestAutoAddingSpawnPoints();
+	TestQueriesMatchBruteForce();
+	TestSaveLoadRoundTrip();
+	TestConcurrentBuildAndReads();
 }
 
 // Called every frame
@@ -71,3 +83,333 @@ void AQTreeTester::TestRandomSpawning()
 
 }
 
+TArray<AActor*> AQTreeTester::SpawnTestPoints(int32 Num)
+{
+	TArray<AActor *> points;
+	points.Reserve(Num);
+	for (int32 i = 0; i < Num; i++)
+	{
+		FVector location(FMath::FRandRange(-TestExtent, TestExtent), FMath::FRandRange(-TestExtent, TestExtent), FMath::FRandRange(-TestExtent, TestExtent));
+		points.Add(GetWorld()->SpawnActor<ATargetPoint>(location, FRotator::ZeroRotator));
+	}
+	return points;
+}
+
+void AQTreeTester::DestroyTestPoints(const TArray<AActor*> &Points)
+{
+	for (AActor *point : Points)
+		point->Destroy();
+}
+
+/**
+ * Gets the squared distance between two locations, ignoring Z unless the tree being tested uses it
+ */
+static float GetTestDistSquared(const FVector &A, const FVector &B, bool bUseZ)
+{
+	return bUseZ ? FVector::DistSquared(A, B) : FVector::DistSquared2D(A, B);
+}
+
+/**
+ * Checks the nearest actors a tree found against every point. Two points can be equally far away, so the results are
+ * compared by distance rather than by actor
+ *
+ * @param Found Actors the tree found, closest first
+ * @param Points Every point in the tree
+ * @param Position Position that was searched around
+ * @param K Number of actors that were asked for
+ * @param bUseZ Whether the tree uses Z
+ * @returns True if the tree found as many actors as it should have, each as close as the matching brute force one
+ */
+static bool MatchesNearest(TArrayView<AActor*> Found, const TArray<AActor*> &Points, FVector Position, int32 K, bool bUseZ)
+{
+	TArray<float> expected;
+	for (AActor *point : Points)
+		expected.Add(GetTestDistSquared(point->GetActorLocation(), Position, bUseZ));
+	expected.Sort();
+	expected.SetNum(FMath::Min(K, expected.Num()));
+
+	if (Found.Num() != expected.Num())
+		return false;
+
+	for (int32 i = 0; i < Found.Num(); i++)
+	{
+		float distance = GetTestDistSquared(Found[i]->GetActorLocation(), Position, bUseZ);
+		if (!FMath::IsNearlyEqual(distance, expected[i], FMath::Max(1.f, expected[i]) * 1e-4f))
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Checks the actors a box query found against every point
+ *
+ * @param Found Actors the query found
+ * @param Points Every point in the tree
+ * @param Min Smallest corner of the box
+ * @param Max Largest corner of the box
+ * @param bUseZ Whether the tree uses Z
+ * @returns True if the query found exactly the points inside the box
+ */
+static bool MatchesBox(const TArray<AActor*> &Found, const TArray<AActor*> &Points, FVector Min, FVector Max, bool bUseZ)
+{
+	TSet<AActor *> expected;
+	for (AActor *point : Points)
+	{
+		FVector location = point->GetActorLocation();
+		bool bInside = location.X >= Min.X && location.X <= Max.X && location.Y >= Min.Y && location.Y <= Max.Y;
+		if (bInside && (!bUseZ || (location.Z >= Min.Z && location.Z <= Max.Z)))
+			expected.Add(point);
+	}
+
+	TSet<AActor *> found(Found);
+	if (found.Num() != Found.Num() || found.Num() != expected.Num())
+		return false;
+
+	for (AActor *point : Found)
+	{
+		if (!expected.Contains(point))
+			return false;
+	}
+	return true;
+}
+
+void AQTreeTester::TestQueriesMatchBruteForce()
+{
+	TArray<AActor *> points = SpawnTestPoints(NumTestPoints);
+	QTree quadTree;
+	quadTree.Build(points);
+	OctTree octTree;
+	octTree.Build(points);
+	LinearQTree linearTree;
+	linearTree.Build(points);
+
+	int32 numFailed = 0;
+	for (int32 query = 0; query < NumTestQueries; query++)
+	{
+		FVector position(FMath::FRandRange(-TestExtent, TestExtent), FMath::FRandRange(-TestExtent, TestExtent), FMath::FRandRange(-TestExtent, TestExtent));
+		FVector2D flatPosition(position.X, position.Y);
+		int32 k = FMath::RandRange(1, 16);
+
+		TArray<AActor *> found;
+		found.SetNumZeroed(k);
+		int32 numFound = quadTree.FindKNearest(flatPosition, k, MAX_FLT, found);
+		bool bQuadNearest = MatchesNearest(MakeArrayView(found.GetData(), numFound), points, position, k, false);
+		numFound = octTree.FindKNearest(position, k, MAX_FLT, found);
+		bool bOctNearest = MatchesNearest(MakeArrayView(found.GetData(), numFound), points, position, k, true);
+		numFound = linearTree.FindKNearest(flatPosition, k, MAX_FLT, found);
+		bool bLinearNearest = MatchesNearest(MakeArrayView(found.GetData(), numFound), points, position, k, false);
+
+		FVector halfSize(FMath::FRandRange(0.f, TestExtent * 0.5f), FMath::FRandRange(0.f, TestExtent * 0.5f), FMath::FRandRange(0.f, TestExtent * 0.5f));
+		FVector boxMin = position - halfSize;
+		FVector boxMax = position + halfSize;
+		TArray<AActor *> inBox;
+		auto collect = [&inBox](AActor *Act, const auto &Position) { inBox.Add(Act); return true; };
+
+		quadTree.QueryBox(FVector2D(boxMin.X, boxMin.Y), FVector2D(boxMax.X, boxMax.Y), collect);
+		bool bQuadBox = MatchesBox(inBox, points, boxMin, boxMax, false);
+		inBox.Reset();
+		octTree.QueryBox(boxMin, boxMax, collect);
+		bool bOctBox = MatchesBox(inBox, points, boxMin, boxMax, true);
+		inBox.Reset();
+		linearTree.QueryRect(FVector2D(boxMin.X, boxMin.Y), FVector2D(boxMax.X, boxMax.Y), collect);
+		bool bLinearBox = MatchesBox(inBox, points, boxMin, boxMax, false);
+
+		if (!bQuadNearest || !bOctNearest || !bLinearNearest || !bQuadBox || !bOctBox || !bLinearBox)
+		{
+			UE_LOG(LogTemp, Error, TEXT("Query %d around %s differs from brute force: nearest %d %d %d, box %d %d %d (quad, oct, linear)"),
+				query, *position.ToString(), bQuadNearest, bOctNearest, bLinearNearest, bQuadBox, bOctBox, bLinearBox);
+			numFailed++;
+		}
+	}
+
+	UE_LOG(LogTemp, Warning, TEXT("Brute force comparison: %d of %d queries failed"), numFailed, NumTestQueries);
+	DestroyTestPoints(points);
+}
+
+/**
+ * Saves a tree, loads it into another and checks both answer every query the same. Then flips one byte of the saved
+ * buffer and checks the checksum turns the load down
+ *
+ * @param Tree Tree to save
+ * @param Queries Positions to compare the trees around
+ * @returns True if the loaded tree matched and the corrupted buffer was refused
+ */
+template<int32 Dim>
+static bool RoundTrips(const TSpatialTree<Dim> &Tree, const TArray<FVector> &Queries)
+{
+	TArray<uint8> buffer;
+	TArray<AActor *> payloads;
+	Tree.Save(buffer, payloads);
+
+	TSpatialTree<Dim> loaded;
+	if (!loaded.Load(buffer, payloads) || loaded.Num() != Tree.Num())
+		return false;
+
+	// Nodes and entries are restored exactly, so even ties come back in the same order
+	TArray<AActor *> expected, found;
+	expected.SetNumZeroed(8);
+	found.SetNumZeroed(8);
+	for (const FVector &query : Queries)
+	{
+		typename TSpatialVector<Dim>::Type position = TSpatialVector<Dim>::FromLocation(query);
+		int32 numExpected = Tree.FindKNearest(position, 8, MAX_FLT, expected);
+		if (loaded.FindKNearest(position, 8, MAX_FLT, found) != numExpected || found != expected)
+			return false;
+	}
+
+	// The last byte belongs to the last stored position, which only the checksum covers
+	buffer.Last() ^= 0xFF;
+	return !loaded.Load(buffer, payloads) && loaded.Num() == 0;
+}
+
+void AQTreeTester::TestSaveLoadRoundTrip()
+{
+	TArray<AActor *> points = SpawnTestPoints(NumTestPoints);
+	TArray<FVector> queries;
+	for (int32 i = 0; i < NumTestQueries; i++)
+		queries.Add(FVector(FMath::FRandRange(-TestExtent, TestExtent), FMath::FRandRange(-TestExtent, TestExtent), FMath::FRandRange(-TestExtent, TestExtent)));
+
+	// Removing a few points leaves free entries behind, which have to survive the round trip as well
+	QTree quadTree;
+	quadTree.Build(points);
+	OctTree octTree;
+	octTree.Build(points);
+	for (int32 i = 0; i < points.Num(); i += 50)
+	{
+		quadTree.Remove(points[i]);
+		octTree.Remove(points[i]);
+	}
+
+	bool bQuadRoundTrips = RoundTrips(quadTree, queries);
+	bool bOctRoundTrips = RoundTrips(octTree, queries);
+
+	// The linear tree refers to actors by their place in a list the caller keeps, and has no checksum of its own
+	LinearQTree linearTree;
+	linearTree.Build(points);
+	TMap<AActor *, int32> pointIndices;
+	for (int32 i = 0; i < points.Num(); i++)
+		pointIndices.Add(points[i], i);
+
+	TArray<uint8> buffer;
+	FMemoryWriter writer(buffer);
+	bool bLinearRoundTrips = linearTree.Save(writer, pointIndices);
+
+	LinearQTree loadedLinearTree;
+	FMemoryReader reader(buffer);
+	bLinearRoundTrips = bLinearRoundTrips && loadedLinearTree.Load(reader, points);
+	for (int32 i = 0; bLinearRoundTrips && i < queries.Num(); i++)
+	{
+		FVector2D position(queries[i].X, queries[i].Y);
+		bLinearRoundTrips = linearTree.FindNearest(position) == loadedLinearTree.FindNearest(position);
+	}
+
+	if (!bQuadRoundTrips || !bOctRoundTrips || !bLinearRoundTrips)
+		UE_LOG(LogTemp, Error, TEXT("Save and load failed: quad %d, oct %d, linear %d"), bQuadRoundTrips, bOctRoundTrips, bLinearRoundTrips);
+
+	UE_LOG(LogTemp, Warning, TEXT("Save and load round trip finished"));
+	DestroyTestPoints(points);
+}
+
+/**
+ * Point stored by the concurrency test, so its trees can be large without spawning an actor for every point
+ */
+struct FStressTestPoint
+{
+	/** Where the point is */
+	FVector Location;
+
+	/** Version of the published tree the point was built into */
+	int32 Version;
+
+	FVector GetActorLocation() const
+	{
+		return Location;
+	}
+};
+
+typedef TSpatialTree<2, const FStressTestPoint*> FStressTestTree;
+
+/**
+ * Builds a tree of the concurrency test's points
+ *
+ * @param Points Points to build the tree from
+ * @returns The tree, owned by the caller
+ */
+static FStressTestTree* NewStressTestTree(const TArray<FStressTestPoint> &Points)
+{
+	TArray<const FStressTestPoint *> payloads;
+	payloads.Reserve(Points.Num());
+	for (const FStressTestPoint &point : Points)
+		payloads.Add(&point);
+
+	FStressTestTree *built = new FStressTestTree();
+	built->Build(payloads);
+	return built;
+}
+
+void AQTreeTester::TestConcurrentBuildAndReads()
+{
+	// Every version holds different points, all tagged with the version they belong to
+	TArray<FStressTestPoint> versionPoints[NumStressTestVersions];
+	for (int32 version = 0; version < NumStressTestVersions; version++)
+	{
+		versionPoints[version].SetNumUninitialized(NumStressTestPoints);
+		for (FStressTestPoint &point : versionPoints[version])
+		{
+			point.Location = FVector(FMath::FRandRange(-TestExtent, TestExtent), FMath::FRandRange(-TestExtent, TestExtent), 0.f);
+			point.Version = version;
+		}
+	}
+
+	// A tree built on worker threads has to answer exactly like a search through every point
+	FStressTestTree *firstVersion = NewStressTestTree(versionPoints[0]);
+	int32 numFailed = firstVersion->Num() == NumStressTestPoints ? 0 : 1;
+	for (int32 query = 0; query < NumTestQueries; query++)
+	{
+		FVector2D position(FMath::FRandRange(-TestExtent, TestExtent), FMath::FRandRange(-TestExtent, TestExtent));
+		float expected = MAX_FLT;
+		for (const FStressTestPoint &point : versionPoints[0])
+			expected = FMath::Min(expected, FVector2D::DistSquared(position, FVector2D(point.Location.X, point.Location.Y)));
+
+		const FStressTestPoint *nearest = firstVersion->FindNearest(position);
+		float distance = nearest ? FVector2D::DistSquared(position, FVector2D(nearest->Location.X, nearest->Location.Y)) : MAX_FLT;
+		if (!FMath::IsNearlyEqual(distance, expected, FMath::Max(1.f, expected) * 1e-4f))
+			numFailed++;
+	}
+
+	// Readers keep querying the published tree while a writer replaces it with the other versions, building each of
+	// them on worker threads as well. Every result must be complete and come from a single version
+	TSpatialSnapshot<FStressTestTree> snapshot;
+	snapshot.Publish(firstVersion);
+	std::atomic<int32> numBadReads(0);
+	ParallelFor(NumStressTestReaders + 1, [&](int32 Task)
+	{
+		if (Task == 0)
+		{
+			for (int32 version = 1; version < NumStressTestVersions; version++)
+				snapshot.Publish(NewStressTestTree(versionPoints[version]));
+			return;
+		}
+
+		FRandomStream random(Task);
+		const FStressTestPoint *found[8];
+		for (int32 read = 0; read < NumStressTestReads; read++)
+		{
+			FVector2D position(random.FRandRange(-TestExtent, TestExtent), random.FRandRange(-TestExtent, TestExtent));
+			TSpatialSnapshot<FStressTestTree>::FReadScope published(snapshot);
+			int32 numFound = published->FindKNearest(position, 8, MAX_FLT, MakeArrayView(found, 8));
+
+			bool bGood = numFound == 8;
+			for (int32 i = 1; bGood && i < numFound; i++)
+				bGood = found[i]->Version == found[0]->Version;
+
+			if (!bGood)
+				numBadReads++;
+		}
+	});
+
+	if (numFailed > 0 || numBadReads > 0)
+		UE_LOG(LogTemp, Error, TEXT("Concurrency test failed: %d wrong nearest points, %d bad reads"), numFailed, numBadReads.load());
+
+	UE_LOG(LogTemp, Warning, TEXT("Concurrency test finished"));
+}
@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "QTree.h"
 #include "QTreeTester.generated.h"
 
 
@@ -19,7 +20,7 @@ public:
 	UPROPERTY(EditAnywhere)
 	TArray<class AActor *> testPoints;
 
-	class QTree *tree;
+	QTree *tree;
 
 protected:
 	// Called when the game starts or when spawned
@@ -37,6 +38,46 @@ private:
 
 	void TestRandomSpawning();
 
+	void TestQueriesMatchBruteForce();
+
+	void TestSaveLoadRoundTrip();
+
+	void TestConcurrentBuildAndReads();
+
+	/**
+	 * Spawns target points at random locations for a test to query
+	 *
+	 * @param Num Number of points to spawn
+	 * @returns The spawned points, to be passed to DestroyTestPoints afterwards
+	 */
+	TArray<class AActor*> SpawnTestPoints(int32 Num);
+
+	/**
+	 * Destroys the points SpawnTestPoints spawned
+	 */
+	void DestroyTestPoints(const TArray<class AActor*> &Points);
+
+	/** Number of target points spawned by the brute force and save tests */
+	static const int32 NumTestPoints = 600;
+
+	/** Number of random queries each test compares */
+	static const int32 NumTestQueries = 200;
+
+	/** Half the size of the cube the test points are spawned in */
+	static constexpr float TestExtent = 5000.f;
+
+	/** Number of points in each tree the concurrency test builds, enough for Build to hand two levels to worker threads */
+	static const int32 NumStressTestPoints = 40000;
+
+	/** Number of trees the concurrency test publishes one after another while readers query them */
+	static const int32 NumStressTestVersions = 6;
+
+	/** Number of threads querying the published tree in the concurrency test */
+	static const int32 NumStressTestReaders = 8;
+
+	/** Number of queries each reader of the concurrency test makes */
+	static const int32 NumStressTestReads = 2000;
+
 	void AssertArrayEqual(TArray<class AActor*> arr1, TArray<class AActor*> arr2)
 	{
 
@@ -0,0 +1,90 @@
+// Copyright (c) 2018 Ryan Dougherty. All rights reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include <atomic>
+
+/**
+ * TRelaxedAtomic holds a value that one writer at a time may change while any number of readers load it without a
+ * lock. Every access is a relaxed atomic, so a reader always sees a whole value but gets no ordering between
+ * different values. Changes are a load followed by a store, so callers must serialize their writers.
+ */
+template<typename ValueType>
+class TRelaxedAtomic
+{
+public:
+	TRelaxedAtomic() : value(ValueType())
+	{
+	}
+
+	TRelaxedAtomic(ValueType Value) : value(Value)
+	{
+	}
+
+	TRelaxedAtomic(const TRelaxedAtomic &Other) : value(Other.Load())
+	{
+	}
+
+	FORCEINLINE TRelaxedAtomic& operator=(const TRelaxedAtomic &Other)
+	{
+		Store(Other.Load());
+		return *this;
+	}
+
+	FORCEINLINE TRelaxedAtomic& operator=(ValueType Value)
+	{
+		Store(Value);
+		return *this;
+	}
+
+	FORCEINLINE operator ValueType() const
+	{
+		return Load();
+	}
+
+	/**
+	 * Reads the value
+	 *
+	 * @returns The last value stored
+	 */
+	FORCEINLINE ValueType Load() const
+	{
+		return value.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * Replaces the value
+	 *
+	 * @param Value The new value
+	 */
+	FORCEINLINE void Store(ValueType Value)
+	{
+		value.store(Value, std::memory_order_relaxed);
+	}
+
+	FORCEINLINE TRelaxedAtomic& operator+=(ValueType Delta)
+	{
+		Store(Load() + Delta);
+		return *this;
+	}
+
+	FORCEINLINE TRelaxedAtomic& operator-=(ValueType Delta)
+	{
+		Store(Load() - Delta);
+		return *this;
+	}
+
+	FORCEINLINE TRelaxedAtomic& operator++()
+	{
+		return *this += 1;
+	}
+
+	FORCEINLINE TRelaxedAtomic& operator--()
+	{
+		return *this -= 1;
+	}
+
+private:
+	std::atomic<ValueType> value;
+};
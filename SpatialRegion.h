@@ -0,0 +1,222 @@
+// Copyright (c) 2018 Ryan Dougherty. All rights reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * How much of a node's boundary lies inside a region
+ */
+enum class ERegionOverlap : uint8
+{
+	/** No point of the boundary is in the region */
+	Outside,
+
+	/** Some points of the boundary may be in the region */
+	Partial,
+
+	/** Every point of the boundary is in the region */
+	Inside
+};
+
+/**
+ * TSpatialRegion is the area a spatial query is limited to: a box, a sphere, or both, with an optional sphere cut out
+ * of it. Within radius R of X but at least D away from Y is a sphere around X with a hole of radius D around Y, and an
+ * annulus is the same with X and Y at the same place.
+ *
+ * Only the first NumAxes axes are tested, so a region over 3D positions that only tests X and Y behaves like a
+ * cylinder or column covering every height.
+ *
+ * @param VectorType Vector type of the positions tested, FVector2D or FVector
+ * @param NumAxes Number of axes tested, starting from X
+ */
+template<typename VectorType, int32 NumAxes>
+struct TSpatialRegion
+{
+	/**
+	 * Makes a region containing every position
+	 */
+	TSpatialRegion() : bHasBox(false), bHasSphere(false), bHasHole(false), SphereRadiusSquared(0.f), HoleRadiusSquared(0.f)
+	{
+	}
+
+	/**
+	 * Makes a region of every position inside a box, edges included
+	 *
+	 * @param Min Smallest corner of the box
+	 * @param Max Largest corner of the box
+	 */
+	static TSpatialRegion Box(const VectorType &Min, const VectorType &Max)
+	{
+		TSpatialRegion region;
+		region.bHasBox = true;
+		region.BoxMin = Min;
+		region.BoxMax = Max;
+		return region;
+	}
+
+	/**
+	 * Makes a region of every position within a radius of a center, edges included
+	 *
+	 * @param Center Center of the sphere
+	 * @param Radius Radius of the sphere
+	 */
+	static TSpatialRegion Sphere(const VectorType &Center, float Radius)
+	{
+		TSpatialRegion region;
+		region.bHasSphere = true;
+		region.SphereCenter = Center;
+		region.SphereRadiusSquared = FMath::Square(Radius);
+		return region;
+	}
+
+	/**
+	 * Makes a region of every position at least MinRadius and at most MaxRadius away from a center
+	 *
+	 * @param Center Center of both spheres
+	 * @param MinRadius Radius of the hole in the middle
+	 * @param MaxRadius Radius of the outer edge
+	 */
+	static TSpatialRegion Annulus(const VectorType &Center, float MinRadius, float MaxRadius)
+	{
+		return Sphere(Center, MaxRadius).Exclude(Center, MinRadius);
+	}
+
+	/**
+	 * Cuts a sphere out of the region. Positions exactly on its edge stay in the region. A region only has one hole,
+	 * so this replaces any earlier one
+	 *
+	 * @param Center Center of the hole
+	 * @param Radius Radius of the hole, nothing is cut out if it is not positive
+	 * @returns This region
+	 */
+	TSpatialRegion & Exclude(const VectorType &Center, float Radius)
+	{
+		bHasHole = Radius > 0.f;
+		HoleCenter = Center;
+		HoleRadiusSquared = FMath::Square(Radius);
+		return *this;
+	}
+
+	/**
+	 * Gets whether a position is in the region
+	 */
+	FORCEINLINE bool Contains(const VectorType &Position) const
+	{
+		if (bHasBox)
+		{
+			for (int32 axis = 0; axis < NumAxes; axis++)
+			{
+				if (Position[axis] < BoxMin[axis] || Position[axis] > BoxMax[axis])
+					return false;
+			}
+		}
+
+		if (bHasSphere && GetDistSquared(Position, SphereCenter) > SphereRadiusSquared)
+			return false;
+
+		return !bHasHole || GetDistSquared(Position, HoleCenter) >= HoleRadiusSquared;
+	}
+
+	/**
+	 * Gets how much of a boundary lies inside the region, so a query can skip the nodes outside it and take the
+	 * nodes inside it whole
+	 *
+	 * @param Min Smallest corner of the boundary
+	 * @param Max Largest corner of the boundary
+	 * @returns Outside or Inside when that is certain for every point of the boundary, otherwise Partial
+	 */
+	ERegionOverlap Classify(const VectorType &Min, const VectorType &Max) const
+	{
+		bool bInside = true;
+		if (bHasBox)
+		{
+			for (int32 axis = 0; axis < NumAxes; axis++)
+			{
+				if (Min[axis] > BoxMax[axis] || Max[axis] < BoxMin[axis])
+					return ERegionOverlap::Outside;
+
+				bInside &= BoxMin[axis] <= Min[axis] && Max[axis] <= BoxMax[axis];
+			}
+		}
+
+		if (bHasSphere)
+		{
+			if (GetDistSquaredToBounds(SphereCenter, Min, Max) > SphereRadiusSquared)
+				return ERegionOverlap::Outside;
+
+			bInside &= GetMaxDistSquaredToBounds(SphereCenter, Min, Max) <= SphereRadiusSquared;
+		}
+
+		if (bHasHole)
+		{
+			if (GetMaxDistSquaredToBounds(HoleCenter, Min, Max) < HoleRadiusSquared)
+				return ERegionOverlap::Outside;
+
+			bInside &= GetDistSquaredToBounds(HoleCenter, Min, Max) >= HoleRadiusSquared;
+		}
+
+		return bInside ? ERegionOverlap::Inside : ERegionOverlap::Partial;
+	}
+
+	/** Whether positions must be inside the box */
+	bool bHasBox;
+
+	/** Whether positions must be inside the sphere */
+	bool bHasSphere;
+
+	/** Whether positions must be outside the hole */
+	bool bHasHole;
+
+	/** Corners of the box */
+	VectorType BoxMin;
+	VectorType BoxMax;
+
+	/** Center and squared radius of the sphere */
+	VectorType SphereCenter;
+	float SphereRadiusSquared;
+
+	/** Center and squared radius of the hole */
+	VectorType HoleCenter;
+	float HoleRadiusSquared;
+
+private:
+	/**
+	 * Gets the squared distance between two positions over the tested axes
+	 */
+	static FORCEINLINE float GetDistSquared(const VectorType &A, const VectorType &B)
+	{
+		float distSquared = 0.f;
+		for (int32 axis = 0; axis < NumAxes; axis++)
+			distSquared += FMath::Square(A[axis] - B[axis]);
+		return distSquared;
+	}
+
+	/**
+	 * Gets the squared distance from a position to the closest point of a boundary over the tested axes
+	 */
+	static FORCEINLINE float GetDistSquaredToBounds(const VectorType &Position, const VectorType &Min, const VectorType &Max)
+	{
+		float distSquared = 0.f;
+		for (int32 axis = 0; axis < NumAxes; axis++)
+		{
+			float d = FMath::Max3(Min[axis] - Position[axis], 0.f, Position[axis] - Max[axis]);
+			distSquared += d * d;
+		}
+		return distSquared;
+	}
+
+	/**
+	 * Gets the squared distance from a position to the furthest point of a boundary over the tested axes
+	 */
+	static FORCEINLINE float GetMaxDistSquaredToBounds(const VectorType &Position, const VectorType &Min, const VectorType &Max)
+	{
+		float distSquared = 0.f;
+		for (int32 axis = 0; axis < NumAxes; axis++)
+		{
+			float d = FMath::Max(FMath::Abs(Position[axis] - Min[axis]), FMath::Abs(Position[axis] - Max[axis]));
+			distSquared += d * d;
+		}
+		return distSquared;
+	}
+};
@@ -0,0 +1,274 @@
+// Copyright (c) 2018 Ryan Dougherty. All rights reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/CriticalSection.h"
+#include "Misc/ScopeLock.h"
+#include <atomic>
+
+/**
+ * TSpatialSnapshot lets any number of threads query a spatial tree while it is being changed. Readers never lock and
+ * never see a change half made: writers change a private copy of the tree and publish it in a single atomic swap.
+ * Versions that have been replaced are only deleted once every reader that could still be using them has finished,
+ * which is tracked with epochs.
+ *
+ * Readers use FReadScope or Read and must only call const members of the tree. Writers use Publish or Modify and are
+ * serialized with each other. The tree type must provide a Clone method for Modify.
+ *
+ * @param TreeType Tree to publish, such as QTree, OctTree or LinearQTree
+ * @param MaxReaders Number of reads that can be running at once before new readers have to wait
+ */
+template<typename TreeType, int32 MaxReaders = 64>
+class TSpatialSnapshot
+{
+public:
+	/**
+	 * FReadScope pins the current version of the tree for as long as it exists. Keep it short lived, since no version
+	 * published after an active read began can be reclaimed until it ends.
+	 */
+	class FReadScope
+	{
+	public:
+		/**
+		 * Pins the most recently published version
+		 *
+		 * @param Snapshot Snapshot to read from
+		 */
+		FReadScope(const TSpatialSnapshot &Snapshot) : owner(Snapshot), slot(Snapshot.EnterRead()), tree(Snapshot.current.load())
+		{
+		}
+
+		/**
+		 * Lets the pinned version be reclaimed
+		 */
+		~FReadScope()
+		{
+			owner.ExitRead(slot);
+		}
+
+		FReadScope(const FReadScope&) = delete;
+		FReadScope& operator=(const FReadScope&) = delete;
+
+		/**
+		 * Gets the pinned version
+		 *
+		 * @returns The tree, or NULL if nothing has been published yet
+		 */
+		FORCEINLINE const TreeType * Get() const
+		{
+			return tree;
+		}
+
+		FORCEINLINE const TreeType * operator->() const
+		{
+			return tree;
+		}
+
+		FORCEINLINE explicit operator bool() const
+		{
+			return tree != NULL;
+		}
+
+	private:
+		/** Snapshot the version was pinned from */
+		const TSpatialSnapshot &owner;
+
+		/** Reader slot held for the lifetime of the scope */
+		int32 slot;
+
+		/** Version pinned by this scope */
+		const TreeType *tree;
+	};
+
+	/**
+	 * Default constructor for a snapshot with nothing published
+	 */
+	TSpatialSnapshot() : current(NULL), epoch(1)
+	{
+		for (int32 i = 0; i < MaxReaders; i++)
+			readerEpochs[i].store(0);
+	}
+
+	/**
+	 * Deletes the current version and every retired one. No reads may still be running
+	 */
+	~TSpatialSnapshot()
+	{
+		delete current.load();
+		for (const FRetired &version : retired)
+			delete version.Tree;
+	}
+
+	TSpatialSnapshot(const TSpatialSnapshot&) = delete;
+	TSpatialSnapshot& operator=(const TSpatialSnapshot&) = delete;
+
+	/**
+	 * Makes a new version visible to every later read. Reads already running keep the version they started with.
+	 *
+	 * @param NewVersion Tree to publish, which the snapshot takes ownership of and which must not be changed again
+	 */
+	void Publish(TreeType *NewVersion)
+	{
+		FScopeLock lock(&writeLock);
+		PublishLocked(NewVersion);
+	}
+
+	/**
+	 * Changes a private copy of the current version and publishes it
+	 *
+	 * @param Func Called as void(TreeType&) with the copy to change
+	 */
+	template<typename FuncType>
+	void Modify(FuncType &&Func)
+	{
+		FScopeLock lock(&writeLock);
+		TreeType *latest = current.load();
+		TreeType *next = latest != NULL ? latest->Clone() : new TreeType();
+		Func(*next);
+		PublishLocked(next);
+	}
+
+	/**
+	 * Changes the current version itself instead of a copy, so nothing is cloned or published. Reads may be running
+	 * against it at the same time, so this is only for changes the tree makes safe to read while they happen, such as
+	 * TSpatialTree::SetEnabled. Serialized with every other writer.
+	 *
+	 * @param Func Called as void(TreeType&) with the current version. Not called if nothing has been published
+	 */
+	template<typename FuncType>
+	void ModifyInPlace(FuncType &&Func)
+	{
+		FScopeLock lock(&writeLock);
+		TreeType *latest = current.load();
+		if (latest != NULL)
+			Func(*latest);
+	}
+
+	/**
+	 * Runs a query against the current version
+	 *
+	 * @param Func Called as Func(const TreeType*) with the pinned version, which is NULL if nothing has been published
+	 * @returns Whatever Func returns
+	 */
+	template<typename FuncType>
+	FORCEINLINE auto Read(FuncType &&Func) const -> decltype(Func((const TreeType*)NULL))
+	{
+		FReadScope scope(*this);
+		return Func(scope.Get());
+	}
+
+	/**
+	 * Deletes every retired version no read can still be using. Publishing does this too, so this is only needed to
+	 * release memory sooner after the last publish.
+	 */
+	void Reclaim()
+	{
+		FScopeLock lock(&writeLock);
+		ReclaimLocked();
+	}
+
+	/**
+	 * Gets whether anything has been published yet
+	 */
+	FORCEINLINE bool IsPublished() const
+	{
+		return current.load() != NULL;
+	}
+
+private:
+	/** Version that has been replaced but may still be pinned by a read */
+	struct FRetired
+	{
+		TreeType *Tree;
+
+		/** Epoch the version was replaced in. Reads that began in this epoch or earlier may be using it */
+		uint64 Epoch;
+	};
+
+	/**
+	 * Swaps in a new version and retires the old one. The write lock must be held
+	 */
+	void PublishLocked(TreeType *NewVersion)
+	{
+		TreeType *oldVersion = current.exchange(NewVersion);
+		if (oldVersion != NULL)
+			retired.Add(FRetired{ oldVersion, epoch.fetch_add(1) });
+
+		ReclaimLocked();
+	}
+
+	/**
+	 * Deletes every retired version older than the oldest running read. The write lock must be held
+	 */
+	void ReclaimLocked()
+	{
+		if (retired.Num() == 0)
+			return;
+
+		uint64 oldestRead = MAX_uint64;
+		for (int32 i = 0; i < MaxReaders; i++)
+		{
+			uint64 readEpoch = readerEpochs[i].load();
+			if (readEpoch != 0)
+				oldestRead = FMath::Min(oldestRead, readEpoch);
+		}
+
+		for (int32 i = retired.Num() - 1; i >= 0; i--)
+		{
+			if (retired[i].Epoch < oldestRead)
+			{
+				delete retired[i].Tree;
+				retired.RemoveAtSwap(i);
+			}
+		}
+	}
+
+	/**
+	 * Claims a reader slot and records the epoch the read began in. This happens before the current version is
+	 * loaded, so a writer that retires the version afterwards always sees the read.
+	 *
+	 * @returns Index of the claimed slot
+	 */
+	int32 EnterRead() const
+	{
+		// Start each thread at its own slot so concurrent readers rarely contend for the same one
+		int32 start = FPlatformTLS::GetCurrentThreadId() % MaxReaders;
+		while (true)
+		{
+			for (int32 i = 0; i < MaxReaders; i++)
+			{
+				int32 slot = (start + i) % MaxReaders;
+				uint64 freeSlot = 0;
+				if (readerEpochs[slot].compare_exchange_strong(freeSlot, epoch.load()))
+					return slot;
+			}
+
+			// Every slot is taken, so wait for a read to finish
+			FPlatformProcess::Yield();
+		}
+	}
+
+	/**
+	 * Releases a reader slot
+	 */
+	FORCEINLINE void ExitRead(int32 Slot) const
+	{
+		readerEpochs[Slot].store(0);
+	}
+
+	/** Most recently published version */
+	std::atomic<TreeType*> current;
+
+	/** Epoch reads begin in, advanced every time a version is retired. Never zero */
+	std::atomic<uint64> epoch;
+
+	/** Epoch each running read began in, or zero for a free slot */
+	mutable std::atomic<uint64> readerEpochs[MaxReaders];
+
+	/** Serializes writers */
+	FCriticalSection writeLock;
+
+	/** Versions waiting for the reads that may use them to finish */
+	TArray<FRetired> retired;
+};
@@ -0,0 +1,2699 @@
+// Copyright (c) 2018 Ryan Dougherty. All rights reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "NodePool.h"
+#include "SplitPolicy.h"
+#include "LeafScan.h"
+#include "Morton.h"
+#include "SpatialRegion.h"
+#include "RelaxedAtomic.h"
+#include "Async/ParallelFor.h"
+#include "Algo/Partition.h"
+#include "Misc/Crc.h"
+#include "Serialization/Archive.h"
+#include "Runtime/Engine/Classes/GameFramework/Actor.h"
+
+/**
+ * TSpatialVector picks the vector type a spatial tree of a given dimension stores positions as
+ */
+template<int32 Dim>
+struct TSpatialVector;
+
+template<>
+struct TSpatialVector<2>
+{
+	typedef FVector2D Type;
+
+	/** Number of bits each axis is quantized to for Morton codes */
+	static const int32 MortonBitsPerAxis = FMorton::BitsPerAxis2D;
+
+	/** Drops the height of a world location */
+	static FORCEINLINE FVector2D FromLocation(const FVector &Location)
+	{
+		return FVector2D(Location.X, Location.Y);
+	}
+
+	/** Interleaves one quantized cell coordinate per axis into a Morton code */
+	static FORCEINLINE uint32 EncodeMorton(const uint32 *Cells)
+	{
+		return FMorton::Encode2D(Cells[0], Cells[1]);
+	}
+};
+
+template<>
+struct TSpatialVector<3>
+{
+	typedef FVector Type;
+
+	/** Number of bits each axis is quantized to for Morton codes */
+	static const int32 MortonBitsPerAxis = FMorton::BitsPerAxis3D;
+
+	/** Keeps the whole world location */
+	static FORCEINLINE FVector FromLocation(const FVector &Location)
+	{
+		return Location;
+	}
+
+	/** Interleaves one quantized cell coordinate per axis into a Morton code */
+	static FORCEINLINE uint32 EncodeMorton(const uint32 *Cells)
+	{
+		return FMorton::Encode3D(Cells[0], Cells[1], Cells[2]);
+	}
+};
+
+/**
+ * FSpatialTreeHandle identifies one entry in a spatial tree. Handles stay the same while the entry is moved around the
+ * tree and stop being valid once it is removed, even if its slot is reused by a later entry.
+ */
+struct FSpatialTreeHandle
+{
+	/** Index of the entry in the tree's entry table */
+	int32 Index = INDEX_NONE;
+
+	/** Serial number the entry had when the handle was made */
+	uint32 Serial = 0;
+
+	/**
+	 * Returns whether the handle refers to an entry at all. Use TSpatialTree::IsValid to check the entry still exists.
+	 */
+	FORCEINLINE bool IsSet() const
+	{
+		return Index != INDEX_NONE;
+	}
+
+	FORCEINLINE explicit operator bool() const
+	{
+		return IsSet();
+	}
+};
+
+/**
+ * TSpatialTree is a generic tree that splits space in half along every axis at each node, giving 2^Dim children per
+ * node: a quad tree in 2D and an oct tree in 3D. The child a position belongs to is built from one comparison bit per
+ * axis, bit 0 for X, bit 1 for Y and bit 2 for Z, where a set bit means the larger side of the node's midpoint.
+ *
+ * Every node stores up to the policy's leaf capacity of payloads before handing new ones down to its children. Nodes
+ * come from a pool owned by the root, and every payload has an entry in a table shared by the whole tree, so payloads
+ * can be found, moved and removed without searching.
+ *
+ * @param Dim Number of axes, 2 or 3
+ * @param PayloadType Type stored in the tree, Actors by default. Adding without a position needs GetActorLocation
+ * @param PolicyType Split policy shared by every node, see FSplitPolicy
+ */
+template<int32 Dim, typename PayloadType = AActor*, typename PolicyType = FSplitPolicy>
+class TSpatialTree
+{
+public:
+	/** Vector type positions are stored as */
+	typedef typename TSpatialVector<Dim>::Type VectorType;
+
+	/** Number of children each node can have */
+	static const int32 NumChildren = 1 << Dim;
+
+	/**
+	 * Default constructor for empty tree with no defined boundaries
+	 */
+	TSpatialTree(int bucketSize = 16) : data(), positions(), shared(new FSharedState(bucketSize)), bOwnsShared(true), parent(NULL), depth(0), numInSubtree(0), numEnabledInSubtree(0), numEnabledInData(0), weightInSubtree(0.0)
+	{
+		this->minBounds = VectorType::ZeroVector;
+		this->maxBounds = VectorType::ZeroVector;
+		this->midPoint = VectorType::ZeroVector;
+
+		for (int i = 0; i < NumChildren; i++)
+			trees[i] = NULL;
+	}
+
+	/**
+	 * Constructor for empty tree specifying boundaries
+	 *
+	 * @param StartBounds Smallest corner of the boundary
+	 * @param EndBounds Largest corner of the boundary
+	 */
+	TSpatialTree(VectorType StartBounds, VectorType EndBounds, int bucketSize = 16) : data(), positions(), shared(new FSharedState(bucketSize)), bOwnsShared(true), parent(NULL), depth(0), numInSubtree(0), numEnabledInSubtree(0), numEnabledInData(0), weightInSubtree(0.0)
+	{
+		this->minBounds = StartBounds;
+		this->maxBounds = EndBounds;
+		this->midPoint = GetMidpoint(StartBounds, EndBounds);
+
+		for (int i = 0; i < NumChildren; i++)
+			trees[i] = NULL;
+	}
+
+	/**
+	 * Constructor for tree with array of Actor points as input
+	 *
+	 * @param Actors list of actors to add to the tree
+	 */
+	TSpatialTree(TArray<PayloadType> Actors, int bucketSize = 16) : data(), positions(), shared(new FSharedState(bucketSize)), bOwnsShared(true), parent(NULL), depth(0), numInSubtree(0), numEnabledInSubtree(0), numEnabledInData(0), weightInSubtree(0.0)
+	{
+		this->minBounds = VectorType::ZeroVector;
+		this->maxBounds = VectorType::ZeroVector;
+		this->midPoint = VectorType::ZeroVector;
+
+		for (int i = 0; i < NumChildren; i++)
+			trees[i] = NULL;
+
+		Build(Actors);
+	}
+
+	TSpatialTree(const TSpatialTree&) = delete;
+	TSpatialTree& operator=(const TSpatialTree&) = delete;
+
+	/**
+	 * Default destructor
+	 */
+	~TSpatialTree()
+	{
+		FreeChildren();
+
+		if (bOwnsShared)
+			delete shared;
+	}
+
+	/**
+	 * Adds an actor to the tree at its current location
+	 *
+	 * @param Act Actor to be added into the tree
+	 * @returns Handle to the actor's entry, which is unset if the actor could not be added
+	 */
+	FORCEINLINE FSpatialTreeHandle Add(PayloadType Act)
+	{
+		return Add(Act, GetPayloadLocation(Act));
+	}
+
+	/**
+	 * Adds an actor to the tree at an explicit position. The position is cached in the tree and used for every
+	 * later query, so the actor itself is never touched again until it is updated or removed.
+	 *
+	 * @param Act Actor to be added into the tree
+	 * @param Position Position to index the actor at
+	 * @returns Handle to the actor's entry, which is unset if the actor could not be added
+	 */
+	FORCEINLINE FSpatialTreeHandle Add(PayloadType Act, VectorType Position)
+	{
+		// An Actor is only ever stored once, so adding it again just moves it and keeps its handle
+		int32 *existingEntry = shared->PayloadEntries.Find(Act);
+		if (existingEntry != NULL)
+		{
+			int32 entryIndex = *existingEntry;
+			return MoveEntry(entryIndex, Position) ? MakeHandle(entryIndex) : FSpatialTreeHandle();
+		}
+
+		// Bounds checking
+		if (!IsInBounds(Position))
+		{
+			if (!bCanExpandBounds)
+				return FSpatialTreeHandle();
+
+			ExpandBounds(Position, minBounds, maxBounds);
+		}
+
+		int32 entryIndex = AllocateEntry(Act);
+		Insert(entryIndex, Position);
+		return MakeHandle(entryIndex);
+	}
+
+	/**
+	 * Replaces everything in the tree with a list of Actors. The bounds are fit exactly around the Actors and every
+	 * node is built once by partitioning the Actors into children in place, which is O(n log n) and much faster
+	 * than adding them one at a time. Large lists are built on worker threads, one subtree per task.
+	 *
+	 * @param Actors List of all actors to store in the tree
+	 * @param Weights Sampling weight of each actor, at the same index. Every actor weighs 1 when this is empty
+	 */
+	void Build(const TArray<PayloadType> &Actors, TArrayView<const float> Weights = TArrayView<const float>())
+	{
+		check(Weights.Num() == 0 || Weights.Num() == Actors.Num());
+		Empty();
+		if (Actors.Num() == 0)
+			return;
+
+		// Cache every position and find the exact bounds in a single pass
+		TArray<FBuildEntry> entries;
+		entries.Reserve(Actors.Num());
+		shared->Entries.Reserve(Actors.Num());
+		shared->PayloadEntries.Reserve(Actors.Num());
+		VectorType smallest = GetPayloadLocation(Actors[0]);
+		VectorType biggest = smallest;
+		for (int32 i = 0; i < Actors.Num(); i++)
+		{
+			// Actors listed more than once are only stored the first time
+			PayloadType act = Actors[i];
+			if (shared->PayloadEntries.Contains(act))
+				continue;
+
+			VectorType location = GetPayloadLocation(act);
+			int32 entryIndex = AllocateEntry(act);
+			if (Weights.Num() > 0)
+				shared->Entries[entryIndex].Weight = FMath::Max(Weights[i], 0.f);
+
+			entries.Add(FBuildEntry{ entryIndex, location });
+
+			for (int32 axis = 0; axis < Dim; axis++)
+			{
+				smallest[axis] = FMath::Min(smallest[axis], location[axis]);
+				biggest[axis] = FMath::Max(biggest[axis], location[axis]);
+			}
+		}
+
+		this->minBounds = smallest;
+		this->maxBounds = biggest;
+		this->midPoint = GetMidpoint(smallest, biggest);
+		BuildRecursive(entries.GetData(), entries.Num(), shared->Pool, ParallelBuildLevels);
+	}
+
+	/**
+	 * Adds a list of actors to the tree
+	 *
+	 * @param Actors List of all actors to add to the tree
+	 */
+	FORCEINLINE bool Add(const TArray<PayloadType> &Actors)
+	{
+		bool status = true;
+		for (PayloadType act : Actors)
+		{
+			if (!this->Add(act))
+				status = false;
+		}
+		return status;
+	}
+
+	/**
+	 * Removes an actor from the tree. Actors sharing the same position cannot be told apart, so prefer removing by
+	 * handle or by actor.
+	 *
+	 * @param Position Position of Actor to remove from the tree
+	 * @returns True if successfully removes an Actor in the tree at the given position
+	 */
+	FORCEINLINE bool Remove(VectorType Position)
+	{
+		int32 entryIndex = FindEntry(Position);
+		if (entryIndex == INDEX_NONE)
+			return false;
+
+		RemoveEntry(entryIndex);
+		return true;
+	}
+
+	/**
+	 * Removes the entry a handle refers to
+	 *
+	 * @param Handle Handle returned when the actor was added
+	 * @returns True if the entry still existed and was removed
+	 */
+	FORCEINLINE bool Remove(FSpatialTreeHandle Handle)
+	{
+		if (!IsValid(Handle))
+			return false;
+
+		RemoveEntry(Handle.Index);
+		return true;
+	}
+
+	/**
+	 * Removes a specific actor from the tree regardless of where it currently is in the world
+	 *
+	 * @param Act Actor to remove from the tree
+	 * @returns True if the actor was found and removed
+	 */
+	FORCEINLINE bool Remove(PayloadType Act)
+	{
+		int32 *entryIndex = shared->PayloadEntries.Find(Act);
+		if (entryIndex == NULL)
+			return false;
+
+		RemoveEntry(*entryIndex);
+		return true;
+	}
+
+	/**
+	 * Moves an actor already in the tree to its current location in the world
+	 *
+	 * @param Act Actor to move in the tree
+	 * @returns True if the actor is still in the tree
+	 */
+	FORCEINLINE bool Update(PayloadType Act)
+	{
+		return Update(Act, GetPayloadLocation(Act));
+	}
+
+	/**
+	 * Moves an actor already in the tree to a new position. Use this for actors that move, since the tree only
+	 * knows the position the actor had when it was added. The actor stays in its node while it still fits there,
+	 * otherwise it climbs to the lowest node containing the new position and is placed again from there, so small
+	 * moves never touch the root.
+	 *
+	 * @param Act Actor to move in the tree
+	 * @param NewPosition The actor's new position
+	 * @returns True if the actor is still in the tree. An actor that moves outside bounds that cannot expand is removed
+	 */
+	FORCEINLINE bool Update(PayloadType Act, VectorType NewPosition)
+	{
+		int32 *entryIndex = shared->PayloadEntries.Find(Act);
+		if (entryIndex == NULL)
+			return false;
+
+		return MoveEntry(*entryIndex, NewPosition);
+	}
+
+	/**
+	 * Moves every actor in a list to its current location in the world. Actors that have not left their node since
+	 * they were last added or updated cost a single lookup.
+	 *
+	 * @param Actors Actors already in the tree that may have moved
+	 * @returns True if every actor is still in the tree
+	 */
+	bool UpdateMoved(TArrayView<PayloadType> Actors)
+	{
+		bool status = true;
+		for (PayloadType act : Actors)
+		{
+			if (!Update(act))
+				status = false;
+		}
+		return status;
+	}
+
+	/**
+	 * Finds an actor in the tree based of off its position
+	 *
+	 * @param Position Position of Actor to find in the tree
+	 * @returns Actor in tree at given position
+	 */
+	FORCEINLINE PayloadType Find(VectorType Position) const
+	{
+		int32 entryIndex = FindEntry(Position);
+		return entryIndex == INDEX_NONE ? PayloadType() : shared->Entries[entryIndex].Payload;
+	}
+
+	/**
+	 * Finds an actor in the tree closest to the desired position
+	 *
+	 * @param Position Position closest to the nearest Actor in the tree
+	 * @returns Actor in tree at nearest position
+	 */
+	FORCEINLINE PayloadType FindNearest(VectorType Position) const
+	{
+		PayloadType nearest = PayloadType();
+		FindKNearest(Position, 1, MAX_FLT, MakeArrayView(&nearest, 1));
+		return nearest;
+	}
+
+	/**
+	 * Finds the actor closest to each of a list of positions. The positions are sorted into Morton order and split
+	 * into runs that are searched in parallel, so each worker walks nodes that are close together and still cached
+	 * from its previous query. The tree must not be changed until the call returns.
+	 *
+	 * @param Queries Positions to search around
+	 * @param OutNearest Caller owned buffer the nearest actor to each query is written to, at the same index
+	 */
+	void FindNearestBatch(TArrayView<const VectorType> Queries, TArrayView<PayloadType> OutNearest) const
+	{
+		int32 num = FMath::Min(Queries.Num(), OutNearest.Num());
+
+		TArray<uint32> codes;
+		codes.SetNumUninitialized(num);
+		for (int32 i = 0; i < num; i++)
+			codes[i] = GetMortonCode(Queries[i]);
+
+		TArray<int32> order;
+		FMorton::RadixSort(codes, order);
+
+		// Runs are long enough to amortize scheduling and short enough to balance across workers
+		const int32 QueriesPerRun = 64;
+		int32 numRuns = (num + QueriesPerRun - 1) / QueriesPerRun;
+		ParallelFor(numRuns, [&](int32 Run)
+		{
+			int32 end = FMath::Min((Run + 1) * QueriesPerRun, num);
+			for (int32 i = Run * QueriesPerRun; i < end; i++)
+			{
+				int32 query = order[i];
+				OutNearest[query] = FindNearest(Queries[query]);
+			}
+		}, numRuns <= 1);
+	}
+
+	/**
+	 * Finds the K enabled actors in the tree closest to the desired position. Nodes are searched best-first in order of
+	 * their distance to the position, so sibling nodes are only opened while they could still hold a closer actor, and
+	 * subtrees with nothing enabled are never opened at all.
+	 * The search uses inline scratch space and only touches the heap for unusually large K or very deep trees.
+	 *
+	 * @param Position Position to search around
+	 * @param K Maximum number of actors to find
+	 * @param MaxDistance Actors further away from the position than this are ignored
+	 * @param OutNearest Caller owned buffer the nearest actors are written to, closest first
+	 * @returns The number of actors written to OutNearest
+	 */
+	int32 FindKNearest(VectorType Position, int32 K, float MaxDistance, TArrayView<PayloadType> OutNearest) const
+	{
+		return FindKNearest(Position, K, MaxDistance, OutNearest, [](PayloadType) { return true; });
+	}
+
+	/**
+	 * Finds the K enabled actors in the tree closest to the desired position that also pass a filter. Rejected actors
+	 * are skipped during the search itself, so up to K accepted actors are always returned and no caller has to
+	 * widen K and search again. The filter is only asked about actors that are close enough to make the results.
+	 *
+	 * @param Position Position to search around
+	 * @param K Maximum number of actors to find
+	 * @param MaxDistance Actors further away from the position than this are ignored
+	 * @param OutNearest Caller owned buffer the nearest actors are written to, closest first
+	 * @param Filter Callable as bool(PayloadType), returning false for actors that must not be returned
+	 * @returns The number of actors written to OutNearest
+	 */
+	template<typename FilterType>
+	int32 FindKNearest(VectorType Position, int32 K, float MaxDistance, TArrayView<PayloadType> OutNearest, FilterType &&Filter) const
+	{
+		K = FMath::Min(K, OutNearest.Num());
+		if (K <= 0 || numEnabledInSubtree == 0)
+			return 0;
+
+		// Nodes still to visit, ordered so the closest node is always on top
+		TArray<FNodeCandidate, TInlineAllocator<64>> nodeQueue;
+		auto closestNodeFirst = [](const FNodeCandidate &A, const FNodeCandidate &B) { return A.DistSquared < B.DistSquared; };
+
+		// Best actors found so far, ordered so the furthest one is on top and can be evicted
+		TArray<FPayloadCandidate, TInlineAllocator<16>> found;
+		auto furthestFirst = [](const FPayloadCandidate &A, const FPayloadCandidate &B) { return A.DistSquared > B.DistSquared; };
+
+		// Distances from the position to every actor in the node being searched
+		TArray<float, TInlineAllocator<64>> distances;
+
+		float cutoff = MaxDistance < MAX_FLT ? FMath::Square(MaxDistance) : MAX_FLT;
+		nodeQueue.HeapPush(FNodeCandidate{ GetDistSquaredToBounds(Position), this }, closestNodeFirst);
+
+		while (nodeQueue.Num() > 0)
+		{
+			FNodeCandidate node;
+			nodeQueue.HeapPop(node, closestNodeFirst, false);
+
+			// Every remaining node is at least this far away, so nothing left can beat the current results
+			if (node.DistSquared > cutoff)
+				break;
+
+			const TSpatialTree *tree = node.Tree;
+			bool bAllEnabled = tree->numEnabledInData == tree->data.Num();
+			bool bNodeSearched = false;
+			if (K == 1 && bAllEnabled)
+			{
+				// The nearest actor settles the node unless the filter rejects it, then the node is searched in full
+				float distance;
+				int32 nearestIndex = tree->positions.FindNearest(Position, distance);
+				bNodeSearched = nearestIndex == INDEX_NONE || distance > cutoff || Filter(tree->data[nearestIndex]);
+				if (nearestIndex != INDEX_NONE && distance <= cutoff && bNodeSearched)
+				{
+					found.Reset();
+					found.Add(FPayloadCandidate{ distance, tree->data[nearestIndex] });
+					cutoff = distance;
+				}
+			}
+
+			if (!bNodeSearched && tree->numEnabledInData > 0)
+			{
+				// Measure the whole node at once, then merge the distances into the results one by one
+				distances.SetNumUninitialized(tree->positions.Num(), false);
+				tree->positions.GetDistSquared(Position, distances.GetData());
+				for (int i = 0; i < distances.Num(); i++)
+				{
+					float distance = distances[i];
+					if (distance > cutoff || (!bAllEnabled && !shared->Entries[tree->entryIndices[i]].bEnabled) || !Filter(tree->data[i]))
+						continue;
+
+					found.HeapPush(FPayloadCandidate{ distance, tree->data[i] }, furthestFirst);
+					if (found.Num() > K)
+						found.HeapPopDiscard(furthestFirst, false);
+
+					// Once K actors are known, only closer ones are worth looking for
+					if (found.Num() == K)
+						cutoff = found.HeapTop().DistSquared;
+				}
+			}
+
+			for (const TSpatialTree *child : tree->trees)
+			{
+				if (child == NULL || child->numEnabledInSubtree == 0)
+					continue;
+
+				float childDist = child->GetDistSquaredToBounds(Position);
+				if (childDist <= cutoff)
+					nodeQueue.HeapPush(FNodeCandidate{ childDist, child }, closestNodeFirst);
+			}
+		}
+
+		// Write the results out closest first
+		int32 numFound = found.Num();
+		for (int32 i = numFound - 1; i >= 0; i--)
+		{
+			OutNearest[i] = found.HeapTop().Payload;
+			found.HeapPopDiscard(furthestFirst, false);
+		}
+		return numFound;
+	}
+
+	/**
+	 * Visits every actor inside an axis aligned box. Subtrees outside the box are skipped and subtrees fully inside
+	 * it are visited without testing each position.
+	 *
+	 * @param Min Smallest corner of the box
+	 * @param Max Largest corner of the box
+	 * @param Visitor Called as bool(PayloadType, const VectorType&) for each actor found, return false to stop the query
+	 * @returns False if the visitor stopped the query early
+	 */
+	template<typename VisitorType>
+	FORCEINLINE bool QueryBox(VectorType Min, VectorType Max, VisitorType &&Visitor) const
+	{
+		return QueryBoxRecursive(Min, Max, Visitor);
+	}
+
+	/**
+	 * Visits every actor within a radius of a position. Subtrees outside the radius are skipped and subtrees fully
+	 * inside it are visited without testing each position.
+	 *
+	 * @param Center Center of the circle or sphere
+	 * @param Radius Radius of the circle or sphere
+	 * @param Visitor Called as bool(PayloadType, const VectorType&) for each actor found, return false to stop the query
+	 * @returns False if the visitor stopped the query early
+	 */
+	template<typename VisitorType>
+	FORCEINLINE bool QuerySphere(VectorType Center, float Radius, VisitorType &&Visitor) const
+	{
+		return QuerySphereRecursive(Center, FMath::Square(Radius), Visitor);
+	}
+
+	/**
+	 * Same as QueryBox, under the name QTree has always used for it
+	 */
+	template<typename VisitorType>
+	FORCEINLINE bool QueryRect(VectorType Min, VectorType Max, VisitorType &&Visitor) const
+	{
+		return QueryBoxRecursive(Min, Max, Visitor);
+	}
+
+	/**
+	 * Same as QuerySphere, under the name QTree has always used for it
+	 */
+	template<typename VisitorType>
+	FORCEINLINE bool QueryRadius(VectorType Center, float Radius, VisitorType &&Visitor) const
+	{
+		return QuerySphereRecursive(Center, FMath::Square(Radius), Visitor);
+	}
+
+	/**
+	 * Gets whether an actor is stored in the tree
+	 *
+	 * @param Act Actor to look for
+	 * @returns True if the actor is in the tree
+	 */
+	FORCEINLINE bool Contains(PayloadType Act) const
+	{
+		return shared->PayloadEntries.Contains(Act);
+	}
+
+	/**
+	 * Gets whether a handle still refers to an entry in the tree
+	 *
+	 * @param Handle Handle returned when the actor was added
+	 * @returns True if the entry has not been removed
+	 */
+	FORCEINLINE bool IsValid(FSpatialTreeHandle Handle) const
+	{
+		return shared->Entries.IsValidIndex(Handle.Index) && shared->Entries[Handle.Index].Serial == Handle.Serial;
+	}
+
+	/**
+	 * Gets the actor a handle refers to
+	 *
+	 * @param Handle Handle returned when the actor was added
+	 * @returns The actor, or nothing if the entry has been removed
+	 */
+	FORCEINLINE PayloadType GetActor(FSpatialTreeHandle Handle) const
+	{
+		return IsValid(Handle) ? shared->Entries[Handle.Index].Payload : PayloadType();
+	}
+
+	/**
+	 * Removes every actor from the tree and returns all of its child trees to the node pool. This is O(n) in the
+	 * number of nodes: each node owns arrays that must be destroyed to release their memory, so every node is visited
+	 * once. Only rewinding the pool afterwards is O(1), and no slab goes back to the heap.
+	 */
+	FORCEINLINE void Empty()
+	{
+		data.Empty();
+		positions.Empty();
+		entryIndices.Empty();
+		FreeChildren();
+		numInSubtree = 0;
+		numEnabledInSubtree = 0;
+		numEnabledInData = 0;
+		weightInSubtree = 0.0;
+
+		// Nothing is handed out anymore, so start carving nodes from the first slab again
+		if (bOwnsShared)
+		{
+			shared->Pool.Reset();
+			shared->Entries.Reset();
+			shared->FirstFreeEntry = INDEX_NONE;
+			shared->PayloadEntries.Reset();
+		}
+	}
+
+	/**
+	 * Makes a deep copy of the tree with its own node pool. Handles keep referring to the same actors in the copy.
+	 * Must be called on the root.
+	 *
+	 * @returns The copy, owned by the caller
+	 */
+	TSpatialTree * Clone() const
+	{
+		TSpatialTree *copy = new TSpatialTree(minBounds, maxBounds, shared->Policy.LeafCapacity);
+		copy->bCanExpandBounds = bCanExpandBounds;
+		copy->shared->Policy = shared->Policy;
+		copy->shared->Entries = shared->Entries;
+		copy->shared->FirstFreeEntry = shared->FirstFreeEntry;
+		copy->shared->NextSerial = shared->NextSerial;
+		copy->shared->PayloadEntries = shared->PayloadEntries;
+		copy->CopyNodes(*this);
+		return copy;
+	}
+
+	/**
+	 * Writes the whole tree into one buffer: a header, then every node depth first, every entry, and the entry and
+	 * position of each stored Actor, every part as one block. Payloads are not written, instead the payload of each
+	 * entry is handed back at the entry's index for the caller to store, and Load takes them back in the same order.
+	 * Handles stay valid across a save and load. Must be called on the root.
+	 *
+	 * @param OutBuffer Replaced with the saved tree
+	 * @param OutPayloads Replaced with the payload of each entry, or nothing for entries not in use
+	 */
+	void Save(TArray<uint8> &OutBuffer, TArray<PayloadType> &OutPayloads) const
+	{
+		// Count everything first so the buffer is allocated once
+		int32 numNodes = CountNodes();
+		int32 numEntries = shared->Entries.Num();
+		int32 numStored = numInSubtree;
+		OutBuffer.Reset();
+		OutBuffer.SetNumZeroed(GetSavedSize(numNodes, numEntries, numStored));
+		OutPayloads.SetNumUninitialized(numEntries);
+
+		uint8 *body = OutBuffer.GetData() + sizeof(FSavedHeader);
+		FSavedNode *savedNodes = reinterpret_cast<FSavedNode*>(body);
+		FSavedEntry *savedEntries = reinterpret_cast<FSavedEntry*>(savedNodes + numNodes);
+		int32 *storedEntries = reinterpret_cast<int32*>(savedEntries + numEntries);
+		VectorType *storedPositions = reinterpret_cast<VectorType*>(storedEntries + numStored);
+
+		int32 nodeIndex = 0;
+		int32 storedIndex = 0;
+		SaveNodes(savedNodes, storedEntries, storedPositions, nodeIndex, storedIndex);
+
+		for (int32 i = 0; i < numEntries; i++)
+		{
+			const FEntry &entry = shared->Entries[i];
+			FSavedEntry &savedEntry = savedEntries[i];
+			savedEntry.Slot = entry.Slot;
+			savedEntry.Serial = entry.Serial;
+			savedEntry.Weight = entry.Weight;
+			savedEntry.bEnabled = entry.bEnabled;
+			OutPayloads[i] = entry.Payload;
+		}
+
+		// The checksum covers the header with its own field zeroed, followed by the body
+		FSavedHeader header;
+		FMemory::Memzero(&header, sizeof(header));
+		header.Magic = SavedMagic;
+		header.Version = FormatVersion;
+		header.NumAxes = Dim;
+		header.NumNodes = numNodes;
+		header.NumEntries = numEntries;
+		header.NumStored = numStored;
+		header.FirstFreeEntry = shared->FirstFreeEntry;
+		header.NextSerial = shared->NextSerial;
+		header.bCanExpandBounds = bCanExpandBounds;
+		header.Policy = shared->Policy;
+		header.Checksum = FCrc::MemCrc32(body, OutBuffer.Num() - sizeof(FSavedHeader), FCrc::MemCrc32(&header, sizeof(header)));
+		FMemory::Memcpy(OutBuffer.GetData(), &header, sizeof(header));
+	}
+
+	/**
+	 * Writes the whole tree to an archive, as its size followed by the buffer the other Save writes
+	 *
+	 * @param Ar Archive to write to
+	 * @param OutPayloads Replaced with the payload of each entry, or nothing for entries not in use
+	 */
+	void Save(FArchive &Ar, TArray<PayloadType> &OutPayloads) const
+	{
+		TArray<uint8> buffer;
+		Save(buffer, OutPayloads);
+
+		int32 size = buffer.Num();
+		Ar << size;
+		Ar.Serialize(buffer.GetData(), size);
+	}
+
+	/**
+	 * Replaces the contents of the tree with a buffer written by Save. Nodes and entries are copied straight out of
+	 * the buffer without placing any Actor again. Must be called on the root.
+	 *
+	 * @param Buffer Buffer written by Save
+	 * @param Payloads Payload of each entry, as handed back by Save
+	 * @returns False if the buffer was written by another version or for another number of axes, does not match its
+	 * checksum, or does not have a payload for each entry, in which case the tree is left empty
+	 */
+	bool Load(const TArray<uint8> &Buffer, TArrayView<const PayloadType> Payloads)
+	{
+		Empty();
+		if (Buffer.Num() < (int32)sizeof(FSavedHeader))
+			return false;
+
+		FSavedHeader header;
+		FMemory::Memcpy(&header, Buffer.GetData(), sizeof(header));
+		if (header.Magic != SavedMagic || header.Version != FormatVersion || header.NumAxes != Dim)
+			return false;
+		if (header.NumNodes < 1 || header.NumEntries < 0 || header.NumStored < 0 || header.NumStored > header.NumEntries || Payloads.Num() != header.NumEntries)
+			return false;
+		if (header.NextSerial == 0 || header.Policy.LeafCapacity < 1 || header.Policy.MaxDepth < 0)
+			return false;
+		if ((int64)Buffer.Num() != GetSavedSize(header.NumNodes, header.NumEntries, header.NumStored))
+			return false;
+
+		const uint8 *body = Buffer.GetData() + sizeof(FSavedHeader);
+		uint32 checksum = header.Checksum;
+		header.Checksum = 0;
+		if (FCrc::MemCrc32(body, Buffer.Num() - sizeof(FSavedHeader), FCrc::MemCrc32(&header, sizeof(header))) != checksum)
+			return false;
+
+		const FSavedNode *savedNodes = reinterpret_cast<const FSavedNode*>(body);
+		const FSavedEntry *savedEntries = reinterpret_cast<const FSavedEntry*>(savedNodes + header.NumNodes);
+		const int32 *storedEntries = reinterpret_cast<const int32*>(savedEntries + header.NumEntries);
+		const VectorType *storedPositions = reinterpret_cast<const VectorType*>(storedEntries + header.NumStored);
+
+		bCanExpandBounds = header.bCanExpandBounds != 0;
+		shared->Policy = header.Policy;
+		shared->FirstFreeEntry = header.FirstFreeEntry;
+		shared->NextSerial = header.NextSerial;
+		shared->Entries.SetNumUninitialized(header.NumEntries);
+		shared->PayloadEntries.Reserve(header.NumStored);
+		int32 numFree = 0;
+		for (int32 i = 0; i < header.NumEntries; i++)
+		{
+			const FSavedEntry &savedEntry = savedEntries[i];
+			if (savedEntry.Serial == 0)
+				numFree++;
+			FEntry &entry = shared->Entries[i];
+			entry.Payload = Payloads[i];
+			entry.Node = NULL;
+			entry.Slot = savedEntry.Slot;
+			entry.Serial = savedEntry.Serial;
+			entry.Weight = savedEntry.Weight;
+			entry.bEnabled = savedEntry.bEnabled != 0;
+
+			// Free entries have no serial number
+			if (entry.Serial != 0)
+				shared->PayloadEntries.Add(entry.Payload, i);
+		}
+
+		// A checksum only proves the buffer is what Save wrote, so every index used later is checked as well. Every
+		// entry in use must hold its own payload, and the free list must visit exactly the free entries once each
+		bool bValid = numFree + header.NumStored == header.NumEntries && shared->PayloadEntries.Num() == header.NumStored;
+		int32 numWalked = 0;
+		int32 freeEntry = shared->FirstFreeEntry;
+		while (bValid && freeEntry != INDEX_NONE)
+		{
+			bValid = shared->Entries.IsValidIndex(freeEntry) && shared->Entries[freeEntry].Serial == 0 && ++numWalked <= numFree;
+			if (bValid)
+				freeEntry = shared->Entries[freeEntry].Slot;
+		}
+
+		if (!bValid || numWalked != numFree)
+		{
+			Empty();
+			return false;
+		}
+
+		int32 nodeIndex = 0;
+		int32 storedIndex = 0;
+		if (!LoadNodes(savedNodes, header.NumNodes, storedEntries, storedPositions, header.NumStored, nodeIndex, storedIndex) || nodeIndex != header.NumNodes || storedIndex != header.NumStored)
+		{
+			Empty();
+			return false;
+		}
+		return true;
+	}
+
+	/**
+	 * Replaces the contents of the tree with one written to an archive by Save. The buffer is read in one block into
+	 * a single allocation.
+	 *
+	 * @param Ar Archive to read from
+	 * @param Payloads Payload of each entry, as handed back by Save
+	 * @returns False if the archive is cut short or Load rejects the buffer, in which case the tree is left empty
+	 */
+	bool Load(FArchive &Ar, TArrayView<const PayloadType> Payloads)
+	{
+		int32 size = 0;
+		Ar << size;
+		if (Ar.IsError() || size < 0 || Ar.TotalSize() - Ar.Tell() < size)
+		{
+			Empty();
+			return false;
+		}
+
+		TArray<uint8> buffer;
+		buffer.SetNumUninitialized(size);
+		Ar.Serialize(buffer.GetData(), size);
+		if (Ar.IsError())
+		{
+			Empty();
+			return false;
+		}
+		return Load(buffer, Payloads);
+	}
+
+	/**
+	 * Saves the tree to or loads it from an archive, depending on which way the archive goes. Payloads cannot be
+	 * written as they are, so they go through a table the caller stores alongside, indexed by entry.
+	 *
+	 * @param Ar Archive to save to or load from
+	 * @param Payloads Filled with the payload of each entry when saving, and read back from when loading
+	 */
+	void Serialize(FArchive &Ar, TArray<PayloadType> &Payloads)
+	{
+		if (Ar.IsLoading())
+		{
+			if (!Load(Ar, Payloads))
+				Ar.SetError();
+		}
+		else
+		{
+			Save(Ar, Payloads);
+		}
+	}
+
+	/**
+	 * Gets the boundaries of the tree
+	 *
+	 * @returns A size 2 array of the smallest corner (index 0) and largest corner (index 1), owned by the caller
+	 */
+	FORCEINLINE VectorType * GetBounds() const
+	{
+		return new VectorType[2]{ minBounds, maxBounds };
+	}
+
+	/**
+	 * Gets the boundaries of the tree
+	 *
+	 * @param OutMin Smallest corner of the boundary
+	 * @param OutMax Largest corner of the boundary
+	 */
+	FORCEINLINE void GetBounds(VectorType &OutMin, VectorType &OutMax) const
+	{
+		OutMin = minBounds;
+		OutMax = maxBounds;
+	}
+
+	/**
+	 * Sets the boundary of the tree and places every Actor in it again
+	 *
+	 * @param Min Smallest corner of the boundary
+	 * @param Max Largest corner of the boundary
+	 */
+	FORCEINLINE void SetBounds(VectorType Min, VectorType Max)
+	{
+		SetBoundsRecursively(Min, Max);
+		Rebalance();
+	}
+
+	/**
+	 * Sets the boundary of the tree with an array of points
+	 *
+	 * @param Bounds Size 2 array of the smallest corner (index 0) and largest corner (index 1)
+	 */
+	FORCEINLINE void SetBounds(VectorType Bounds[2])
+	{
+		SetBounds(Bounds[0], Bounds[1]);
+	}
+
+	/**
+	 * Returns an array of all Actors in the tree
+	 *
+	 * @returns An array of all of the Actors in the tree
+	 */
+	FORCEINLINE TArray<PayloadType> GetAllActors() const
+	{
+		TArray<PayloadType> actors;
+		Traverse(actors);
+		return actors;
+	}
+
+	/**
+	 * Gets the number of Actors in this tree and all of its children
+	 *
+	 * @returns Number of Actors in the tree
+	 */
+	FORCEINLINE int32 Num() const
+	{
+		return numInSubtree;
+	}
+
+	/**
+	 * Gets an Actor by its index in the order GetAllActors lists them, without building the list. Every node knows
+	 * how many Actors are below it, so this is a single walk down the tree. Disabled Actors are counted too.
+	 *
+	 * @param Index Index of the Actor, from 0 to Num() - 1
+	 * @returns The Actor at that index
+	 */
+	PayloadType GetActorAt(int32 Index) const
+	{
+		const TSpatialTree *tree = this;
+		while (Index >= tree->data.Num())
+		{
+			Index -= tree->data.Num();
+			for (const TSpatialTree *child : tree->trees)
+			{
+				if (child == NULL)
+					continue;
+
+				if (Index < child->numInSubtree)
+				{
+					tree = child;
+					break;
+				}
+				Index -= child->numInSubtree;
+			}
+		}
+		return tree->data[Index];
+	}
+
+	/**
+	 * Picks an enabled Actor uniformly at random in O(log n), without allocating
+	 *
+	 * @returns A random Actor, or nothing if no Actor is enabled
+	 */
+	FORCEINLINE PayloadType GetRandomActor() const
+	{
+		int32 numEnabled = numEnabledInSubtree;
+		return numEnabled > 0 ? GetEnabledActorAt(FMath::RandRange(0, numEnabled - 1)) : PayloadType();
+	}
+
+	/**
+	 * Picks an enabled Actor at random with a chance proportional to its weight, in O(log n) and without allocating
+	 *
+	 * @returns A random Actor, or nothing if no Actor is enabled or every weight is zero
+	 */
+	FORCEINLINE PayloadType GetWeightedRandomActor() const
+	{
+		double totalWeight = weightInSubtree;
+		return totalWeight > 0.0 ? GetActorAtWeight(FMath::FRand() * totalWeight) : PayloadType();
+	}
+
+	/**
+	 * Picks an enabled Actor at random from the Actors inside a region. Nodes outside the region are skipped, nodes inside it
+	 * are weighed as a whole from their totals, and only the Actors of nodes crossing its edge are tested one by one,
+	 * so no list of candidates is ever built. The region's total is found first, then a single random draw is walked
+	 * down to the Actor it lands on.
+	 *
+	 * @param Region Region the Actor must be in, such as TSpatialRegion<VectorType, Dim>::Annulus
+	 * @param bWeighted Whether Actors are picked in proportion to their weight instead of uniformly
+	 * @returns A random Actor in the region, or nothing if there are none
+	 */
+	template<typename RegionType>
+	PayloadType GetRandomActorInRegion(const RegionType &Region, bool bWeighted = true) const
+	{
+		double total = SumRegionRecursive(Region, bWeighted);
+		if (total <= 0.0)
+			return PayloadType();
+
+		FRegionPick pick;
+		pick.Target = FMath::FRand() * total;
+		if (PickInRegionRecursive(Region, bWeighted, pick))
+			return pick.Payload;
+
+		// Rounding left the target just past the end, where the last candidate takes it
+		if (pick.Tree != NULL)
+			return bWeighted ? pick.Tree->GetActorAtWeight(pick.Tree->weightInSubtree) : pick.Tree->GetEnabledActorAt(pick.Tree->numEnabledInSubtree - 1);
+		return pick.Payload;
+	}
+
+	/**
+	 * Visits every actor inside a region, enabled or not
+	 *
+	 * @param Region Region to search, such as TSpatialRegion<VectorType, Dim>::Sphere
+	 * @param Visitor Called as bool(PayloadType, const VectorType&) for each actor found, return false to stop the query
+	 * @returns False if the visitor stopped the query early
+	 */
+	template<typename RegionType, typename VisitorType>
+	FORCEINLINE bool QueryRegion(const RegionType &Region, VisitorType &&Visitor) const
+	{
+		return QueryRegionRecursive(Region, Visitor);
+	}
+
+	/**
+	 * Sets how likely an actor is to be picked by weighted random picks, relative to the other actors
+	 *
+	 * @param Act Actor already in the tree
+	 * @param Weight New weight, clamped to zero or more. Actors weigh 1 when added
+	 * @returns True if the actor is in the tree
+	 */
+	bool SetWeight(PayloadType Act, float Weight)
+	{
+		int32 *entryIndex = shared->PayloadEntries.Find(Act);
+		if (entryIndex == NULL)
+			return false;
+
+		SetEntryWeight(*entryIndex, Weight);
+		return true;
+	}
+
+	/**
+	 * Sets how likely the entry a handle refers to is to be picked by weighted random picks
+	 *
+	 * @param Handle Handle returned when the actor was added
+	 * @param Weight New weight, clamped to zero or more
+	 * @returns True if the entry still exists
+	 */
+	bool SetWeight(FSpatialTreeHandle Handle, float Weight)
+	{
+		if (!IsValid(Handle))
+			return false;
+
+		SetEntryWeight(Handle.Index, Weight);
+		return true;
+	}
+
+	/**
+	 * Gets the weight of an actor
+	 *
+	 * @param Act Actor to look up
+	 * @returns The actor's weight, or zero if it is not in the tree
+	 */
+	FORCEINLINE float GetWeight(PayloadType Act) const
+	{
+		const int32 *entryIndex = shared->PayloadEntries.Find(Act);
+		return entryIndex != NULL ? shared->Entries[*entryIndex].Weight : 0.f;
+	}
+
+	/**
+	 * Gets the total weight of every enabled Actor in this tree and its children
+	 */
+	FORCEINLINE double GetTotalWeight() const
+	{
+		return weightInSubtree;
+	}
+
+	/**
+	 * Enables or disables an actor. Disabled actors stay where they are in the tree but are skipped by nearest and
+	 * random queries, which also skip every subtree with nothing enabled. Only the totals along the path to the root
+	 * change, so toggling costs O(depth) and never restructures the tree. That also makes it the one change that may be
+	 * made to a tree other threads are querying, as long as only one thread toggles at a time: readers see each
+	 * actor's flag and each total whole, though briefly out of step with each other, and a random pick that lands
+	 * on such a gap returns nothing
+	 *
+	 * @param Act Actor already in the tree
+	 * @param bEnabled Whether the actor can be returned by nearest and random queries. Actors are enabled when added
+	 * @returns True if the actor is in the tree
+	 */
+	bool SetEnabled(PayloadType Act, bool bEnabled)
+	{
+		int32 *entryIndex = shared->PayloadEntries.Find(Act);
+		if (entryIndex == NULL)
+			return false;
+
+		SetEntryEnabled(*entryIndex, bEnabled);
+		return true;
+	}
+
+	/**
+	 * Enables or disables the entry a handle refers to
+	 *
+	 * @param Handle Handle returned when the actor was added
+	 * @param bEnabled Whether the actor can be returned by nearest and random queries
+	 * @returns True if the entry still exists
+	 */
+	bool SetEnabled(FSpatialTreeHandle Handle, bool bEnabled)
+	{
+		if (!IsValid(Handle))
+			return false;
+
+		SetEntryEnabled(Handle.Index, bEnabled);
+		return true;
+	}
+
+	/**
+	 * Gets whether an actor is enabled
+	 *
+	 * @param Act Actor to look up
+	 * @returns True if the actor is in the tree and enabled
+	 */
+	FORCEINLINE bool IsEnabled(PayloadType Act) const
+	{
+		const int32 *entryIndex = shared->PayloadEntries.Find(Act);
+		return entryIndex != NULL && shared->Entries[*entryIndex].bEnabled;
+	}
+
+	/**
+	 * Gets the number of enabled Actors in this tree and all of its children
+	 */
+	FORCEINLINE int32 NumEnabled() const
+	{
+		return numEnabledInSubtree;
+	}
+
+	/**
+	 * Returns whether or not the tree has child trees
+	 *
+	 * @returns True if the tree has any child trees
+	 */
+	FORCEINLINE bool HasChildren() const
+	{
+		for (const TSpatialTree *tree : trees)
+		{
+			if (tree != NULL)
+				return true;
+		}
+		return false;
+	}
+
+	/**
+	 * Changes the rules every node in the tree splits by. Actors already in the tree are placed again under the new
+	 * rules.
+	 *
+	 * @param Policy New split policy for the whole tree
+	 */
+	void SetSplitPolicy(const PolicyType &Policy)
+	{
+		shared->Policy = Policy;
+		if (data.Num() > 0 || HasChildren())
+			Rebalance();
+	}
+
+	/**
+	 * Gets the rules every node in the tree splits by
+	 *
+	 * @returns The tree's split policy
+	 */
+	FORCEINLINE const PolicyType & GetSplitPolicy() const
+	{
+		return shared->Policy;
+	}
+
+	/**
+	 * Determines whether or not the tree grows to fit Actors added outside of its boundary
+	 */
+	bool bCanExpandBounds = true;
+
+private:
+	friend class TNodePool<TSpatialTree>;
+
+	/** Node waiting to be searched by FindKNearest */
+	struct FNodeCandidate
+	{
+		float DistSquared;
+		const TSpatialTree *Tree;
+	};
+
+	/** Actor found by FindKNearest */
+	struct FPayloadCandidate
+	{
+		float DistSquared;
+		PayloadType Payload;
+	};
+
+	/** Random pick over a region, walking the candidates towards a target total */
+	struct FRegionPick
+	{
+		/** Total left to walk past */
+		double Target = 0.0;
+
+		/** Actor picked, or the last single Actor walked past */
+		PayloadType Payload = PayloadType();
+
+		/** Last candidate walked past when it was a whole subtree, otherwise NULL */
+		const TSpatialTree *Tree = NULL;
+	};
+
+	/** Start of every buffer written by Save */
+	struct alignas(8) FSavedHeader
+	{
+		uint32 Magic;
+		uint32 Version;
+		uint32 Checksum;
+		int32 NumAxes;
+		int32 NumNodes;
+		int32 NumEntries;
+		int32 NumStored;
+		int32 FirstFreeEntry;
+		uint32 NextSerial;
+		uint32 bCanExpandBounds;
+		PolicyType Policy;
+	};
+
+	/** Node as written by Save. Each node is followed by its children, depth first */
+	struct FSavedNode
+	{
+		VectorType MinBounds;
+		VectorType MaxBounds;
+		VectorType MidPoint;
+		double WeightInSubtree;
+		int32 NumInSubtree;
+		int32 NumEnabledInSubtree;
+		int32 NumEnabledInData;
+
+		/** Number of Actors in the node's own data */
+		int32 NumData;
+
+		/** One bit for each child the node has */
+		uint32 ChildMask;
+	};
+
+	/** Entry as written by Save. Which node it is in is found again when the nodes are loaded */
+	struct FSavedEntry
+	{
+		int32 Slot;
+		uint32 Serial;
+		float Weight;
+		uint32 bEnabled;
+	};
+
+	/** Actor waiting to be placed by Build */
+	struct FBuildEntry
+	{
+		int32 EntryIndex;
+		VectorType Position;
+	};
+
+	/** Where one actor is stored in the tree. Free entries keep the index of the next free entry in Slot */
+	struct FEntry
+	{
+		PayloadType Payload;
+		TSpatialTree *Node;
+		int32 Slot;
+		uint32 Serial;
+
+		/** Chance of being picked by a weighted random pick, relative to the other entries */
+		float Weight;
+
+		/** Whether nearest and random queries may return the entry. Atomic so it can be toggled while readers query */
+		TRelaxedAtomic<bool> bEnabled;
+	};
+
+	/** State shared by every node of one tree, owned by the root */
+	struct FSharedState
+	{
+		FSharedState(int bucketSize) : Policy(bucketSize)
+		{
+		}
+
+		/** Pool every node in the tree is allocated from */
+		TNodePool<TSpatialTree> Pool;
+
+		/** Rules every node in the tree splits by */
+		PolicyType Policy;
+
+		/** Every entry handed out by the tree, indexed by handle */
+		TArray<FEntry> Entries;
+
+		/** Most recently freed entry */
+		int32 FirstFreeEntry = INDEX_NONE;
+
+		/** Serial number given to the next entry, never zero */
+		uint32 NextSerial = 1;
+
+		/** Entry of each Actor in the tree */
+		TMap<PayloadType, int32> PayloadEntries;
+	};
+
+	/**
+	 * Constructor for child trees sharing their root's state
+	 *
+	 * @param StartBounds Smallest corner of the boundary
+	 * @param EndBounds Largest corner of the boundary
+	 * @param Parent Tree this tree is a child of
+	 */
+	TSpatialTree(VectorType StartBounds, VectorType EndBounds, TSpatialTree *Parent) : data(), positions(), shared(Parent->shared), bOwnsShared(false), parent(Parent), depth(Parent->depth + 1), numInSubtree(0), numEnabledInSubtree(0), numEnabledInData(0), weightInSubtree(0.0)
+	{
+		this->minBounds = StartBounds;
+		this->maxBounds = EndBounds;
+		this->midPoint = GetMidpoint(StartBounds, EndBounds);
+		this->bCanExpandBounds = Parent->bCanExpandBounds;
+
+		for (int i = 0; i < NumChildren; i++)
+			trees[i] = NULL;
+	}
+
+	/**
+	 * Copies the contents of another tree and all of its children into this tree, pointing every copied entry at its
+	 * new node. This tree must be empty and have the same bounds as the source.
+	 *
+	 * @param Source Tree to copy from
+	 */
+	void CopyNodes(const TSpatialTree &Source)
+	{
+		midPoint = Source.midPoint;
+		numInSubtree = Source.numInSubtree;
+		numEnabledInSubtree = Source.numEnabledInSubtree;
+		numEnabledInData = Source.numEnabledInData;
+		weightInSubtree = Source.weightInSubtree;
+		data = Source.data;
+		positions = Source.positions;
+		entryIndices = Source.entryIndices;
+		for (int32 entryIndex : entryIndices)
+			shared->Entries[entryIndex].Node = this;
+
+		for (int i = 0; i < NumChildren; i++)
+		{
+			const TSpatialTree *child = Source.trees[i];
+			if (child != NULL)
+			{
+				trees[i] = shared->Pool.Allocate(child->minBounds, child->maxBounds, this);
+				trees[i]->CopyNodes(*child);
+			}
+		}
+	}
+
+	/**
+	 * Gets the number of bytes Save writes for a tree
+	 */
+	static FORCEINLINE int64 GetSavedSize(int32 NumNodes, int32 NumEntries, int32 NumStored)
+	{
+		return sizeof(FSavedHeader) + (int64)NumNodes * sizeof(FSavedNode) + (int64)NumEntries * sizeof(FSavedEntry) + (int64)NumStored * (sizeof(int32) + sizeof(VectorType));
+	}
+
+	/**
+	 * Gets the number of nodes in this tree and all of its children
+	 */
+	int32 CountNodes() const
+	{
+		int32 numNodes = 1;
+		for (const TSpatialTree *child : trees)
+			if (child != NULL)
+				numNodes += child->CountNodes();
+		return numNodes;
+	}
+
+	/**
+	 * Writes this tree and then each of its children, depth first
+	 *
+	 * @param OutNodes Every saved node
+	 * @param OutStoredEntries Entry of every stored Actor, in the order the nodes are written
+	 * @param OutStoredPositions Position of every stored Actor, at the same index
+	 * @param NodeIndex Index of the next node to write, moved past every node written
+	 * @param StoredIndex Index of the next stored Actor to write, moved past every Actor written
+	 */
+	void SaveNodes(FSavedNode *OutNodes, int32 *OutStoredEntries, VectorType *OutStoredPositions, int32 &NodeIndex, int32 &StoredIndex) const
+	{
+		FSavedNode &savedNode = OutNodes[NodeIndex++];
+		savedNode.MinBounds = minBounds;
+		savedNode.MaxBounds = maxBounds;
+		savedNode.MidPoint = midPoint;
+		savedNode.WeightInSubtree = weightInSubtree;
+		savedNode.NumInSubtree = numInSubtree;
+		savedNode.NumEnabledInSubtree = numEnabledInSubtree;
+		savedNode.NumEnabledInData = numEnabledInData;
+		savedNode.NumData = data.Num();
+		savedNode.ChildMask = 0;
+		for (int i = 0; i < NumChildren; i++)
+			if (trees[i] != NULL)
+				savedNode.ChildMask |= 1 << i;
+
+		for (int32 i = 0; i < data.Num(); i++)
+		{
+			OutStoredEntries[StoredIndex] = entryIndices[i];
+			OutStoredPositions[StoredIndex] = positions.Get(i);
+			StoredIndex++;
+		}
+
+		for (const TSpatialTree *child : trees)
+			if (child != NULL)
+				child->SaveNodes(OutNodes, OutStoredEntries, OutStoredPositions, NodeIndex, StoredIndex);
+	}
+
+	/**
+	 * Reads this tree and then each of its children as written by SaveNodes, pointing every entry at the node that
+	 * stores it. This tree must be empty.
+	 *
+	 * @returns False if a node runs past the end of the saved nodes, stores an entry that is free or already stored,
+	 * or has totals that do not add up from its data and children
+	 */
+	bool LoadNodes(const FSavedNode *Nodes, int32 NumNodes, const int32 *StoredEntries, const VectorType *StoredPositions, int32 NumStored, int32 &NodeIndex, int32 &StoredIndex)
+	{
+		const FSavedNode &savedNode = Nodes[NodeIndex++];
+		minBounds = savedNode.MinBounds;
+		maxBounds = savedNode.MaxBounds;
+		midPoint = savedNode.MidPoint;
+		weightInSubtree = savedNode.WeightInSubtree;
+		numInSubtree = savedNode.NumInSubtree;
+		numEnabledInSubtree = savedNode.NumEnabledInSubtree;
+		numEnabledInData = savedNode.NumEnabledInData;
+		if (savedNode.NumData < 0 || savedNode.NumData > NumStored - StoredIndex || (savedNode.ChildMask >> NumChildren) != 0)
+			return false;
+
+		data.Reserve(savedNode.NumData);
+		entryIndices.Reserve(savedNode.NumData);
+		int32 numEnabled = 0;
+		for (int32 i = 0; i < savedNode.NumData; i++)
+		{
+			int32 entryIndex = StoredEntries[StoredIndex];
+			if (!shared->Entries.IsValidIndex(entryIndex) || shared->Entries[entryIndex].Serial == 0 || shared->Entries[entryIndex].Node != NULL)
+				return false;
+
+			FEntry &entry = shared->Entries[entryIndex];
+			entry.Node = this;
+			entry.Slot = i;
+			if (entry.bEnabled)
+				numEnabled++;
+
+			data.Add(entry.Payload);
+			positions.Add(StoredPositions[StoredIndex]);
+			entryIndices.Add(entryIndex);
+			StoredIndex++;
+		}
+
+		for (int i = 0; i < NumChildren; i++)
+		{
+			if ((savedNode.ChildMask & (1 << i)) == 0)
+				continue;
+			if (NodeIndex >= NumNodes)
+				return false;
+
+			trees[i] = shared->Pool.Allocate(VectorType::ZeroVector, VectorType::ZeroVector, this);
+			if (!trees[i]->LoadNodes(Nodes, NumNodes, StoredEntries, StoredPositions, NumStored, NodeIndex, StoredIndex))
+				return false;
+		}
+
+		// Random picks walk down the tree by these totals, so they have to match what is actually stored
+		int32 numStored = data.Num();
+		int32 numEnabledStored = numEnabled;
+		for (const TSpatialTree *child : trees)
+			if (child != NULL)
+			{
+				numStored += child->numInSubtree;
+				numEnabledStored += child->numEnabledInSubtree;
+			}
+		return numEnabled == numEnabledInData && numStored == numInSubtree && numEnabledStored == numEnabledInSubtree;
+	}
+
+	/**
+	 * Gets the location of an actor as a position in this tree
+	 */
+	static FORCEINLINE VectorType GetPayloadLocation(const PayloadType &Act)
+	{
+		return TSpatialVector<Dim>::FromLocation(Act->GetActorLocation());
+	}
+
+	/**
+	 * Returns every child tree, and in turn their children, to the node pool
+	 */
+	void FreeChildren()
+	{
+		for (int i = 0; i < NumChildren; i++)
+			if (trees[i] != NULL)
+			{
+				shared->Pool.Free(trees[i]);
+				trees[i] = NULL;
+			}
+	}
+
+	/**
+	 * Returns a child tree to the node pool if it no longer holds anything
+	 *
+	 * @param Index Index of the child in trees
+	 */
+	void FreeChildIfEmpty(int Index)
+	{
+		TSpatialTree *child = trees[Index];
+		if (child != NULL && child->data.Num() == 0 && !child->HasChildren())
+		{
+			shared->Pool.Free(child);
+			trees[Index] = NULL;
+		}
+	}
+
+	/**
+	 * Merges child trees back into this tree when they can all fit in its data, then keeps going up the tree while
+	 * each parent is left without children. Empty children are always freed.
+	 */
+	void CollapseUpwards()
+	{
+		TSpatialTree *tree = this;
+		while (true)
+		{
+			tree->MergeChildren();
+			if (tree->parent == NULL || tree->HasChildren())
+				break;
+
+			tree = tree->parent;
+		}
+	}
+
+	/**
+	 * Frees every empty child and moves the data of the rest into this tree if none of them have children and all of
+	 * their data fits in this tree's bucket
+	 */
+	void MergeChildren()
+	{
+		int total = data.Num();
+		for (int i = 0; i < NumChildren; i++)
+		{
+			FreeChildIfEmpty(i);
+			if (trees[i] == NULL)
+				continue;
+
+			if (trees[i]->HasChildren())
+				return;
+
+			total += trees[i]->data.Num();
+		}
+
+		if (total > shared->Policy.LeafCapacity)
+			return;
+
+		for (int i = 0; i < NumChildren; i++)
+		{
+			TSpatialTree *child = trees[i];
+			if (child == NULL)
+				continue;
+
+			for (int j = 0; j < child->data.Num(); j++)
+				AddToData(child->entryIndices[j], child->positions.Get(j));
+
+			shared->Pool.Free(child);
+			trees[i] = NULL;
+		}
+	}
+
+	/**
+	 * Places an entry in this tree or below it, creating child trees as needed. The position must be inside this
+	 * tree's bounds.
+	 *
+	 * @param EntryIndex Entry of the actor to place
+	 * @param Position Position to index the actor at
+	 */
+	void Insert(int32 EntryIndex, VectorType Position)
+	{
+		// Walk down until a tree with enough space is found, or one that is not allowed to split
+		TSpatialTree *tree = this;
+		while (tree->data.Num() >= shared->Policy.LeafCapacity && tree->CanSplit())
+			tree = tree->GetOrCreateChild(tree->GetChildIndex(Position));
+
+		tree->AddToData(EntryIndex, Position);
+		tree->ChangeSubtreeTotals(1, shared->Entries[EntryIndex].bEnabled ? 1 : 0, GetPickWeight(EntryIndex));
+	}
+
+	/**
+	 * Finds the entry stored at a position by walking down the only path the position can be stored along
+	 *
+	 * @param Position Position to look for
+	 * @returns The entry at the position, or INDEX_NONE
+	 */
+	int32 FindEntry(VectorType Position) const
+	{
+		if (!IsInBounds(Position))
+			return INDEX_NONE;
+
+		const TSpatialTree *tree = this;
+		while (tree != NULL)
+		{
+			int32 slot = tree->positions.FindEqual(Position);
+			if (slot != INDEX_NONE)
+				return tree->entryIndices[slot];
+
+			tree = tree->trees[tree->GetChildIndex(Position)];
+		}
+		return INDEX_NONE;
+	}
+
+	/**
+	 * Gets one of the child trees, creating it if it does not exist yet
+	 *
+	 * @param Index Index of the child
+	 * @returns The child tree covering that part of this tree
+	 */
+	FORCEINLINE TSpatialTree * GetOrCreateChild(int32 Index)
+	{
+		return GetOrCreateChild(Index, shared->Pool);
+	}
+
+	/**
+	 * Gets one of the child trees, creating it from a given pool if it does not exist yet
+	 *
+	 * @param Index Index of the child
+	 * @param Pool Pool to allocate the child from, which must end up absorbed into the tree's pool
+	 * @returns The child tree covering that part of this tree
+	 */
+	TSpatialTree * GetOrCreateChild(int32 Index, TNodePool<TSpatialTree> &Pool)
+	{
+		if (trees[Index] == NULL)
+		{
+			VectorType childMin, childMax;
+			GetChildBounds(Index, minBounds, maxBounds, childMin, childMax);
+			trees[Index] = Pool.Allocate(childMin, childMax, this);
+		}
+		return trees[Index];
+	}
+
+	/**
+	 * Gets the boundary of a child from the boundary of its parent. Each bit of the index picks the upper or lower
+	 * half of one axis.
+	 *
+	 * @param Index Index of the child
+	 * @param Min Smallest corner of the parent
+	 * @param Max Largest corner of the parent
+	 * @param OutMin Smallest corner of the child
+	 * @param OutMax Largest corner of the child
+	 */
+	FORCEINLINE void GetChildBounds(int32 Index, const VectorType &Min, const VectorType &Max, VectorType &OutMin, VectorType &OutMax) const
+	{
+		for (int32 axis = 0; axis < Dim; axis++)
+		{
+			bool bUpper = (Index >> axis) & 1;
+			OutMin[axis] = bUpper ? midPoint[axis] : Min[axis];
+			OutMax[axis] = bUpper ? Max[axis] : midPoint[axis];
+		}
+	}
+
+	/**
+	 * Stores an entry in this tree's data and points the entry at it
+	 *
+	 * @param EntryIndex Entry of the actor to store
+	 * @param Position Position of the actor
+	 */
+	FORCEINLINE void AddToData(int32 EntryIndex, VectorType Position)
+	{
+		FEntry &entry = shared->Entries[EntryIndex];
+		entry.Node = this;
+		entry.Slot = data.Num();
+		if (entry.bEnabled)
+			++numEnabledInData;
+
+		data.Add(entry.Payload);
+		positions.Add(Position);
+		entryIndices.Add(EntryIndex);
+	}
+
+	/**
+	 * Drops an entry from this tree's data. The order of data is not meaningful so the last entry fills the gap.
+	 *
+	 * @param Slot Index of the entry in data
+	 */
+	FORCEINLINE void RemoveFromData(int32 Slot)
+	{
+		if (shared->Entries[entryIndices[Slot]].bEnabled)
+			--numEnabledInData;
+
+		data.RemoveAtSwap(Slot);
+		positions.RemoveAtSwap(Slot);
+		entryIndices.RemoveAtSwap(Slot);
+
+		if (Slot < entryIndices.Num())
+			shared->Entries[entryIndices[Slot]].Slot = Slot;
+	}
+
+	/**
+	 * Adjusts the number of Actors, the number of enabled Actors and their total weight counted in this tree and every
+	 * tree above it, after an Actor is stored in or dropped from this tree's data or has its weight or enabled bit changed
+	 *
+	 * @param CountDelta Number of Actors added, negative for Actors removed
+	 * @param EnabledDelta Number of enabled Actors added, negative for enabled Actors removed
+	 * @param WeightDelta Weight added, negative for weight removed
+	 */
+	FORCEINLINE void ChangeSubtreeTotals(int32 CountDelta, int32 EnabledDelta, double WeightDelta)
+	{
+		for (TSpatialTree *tree = this; tree != NULL; tree = tree->parent)
+		{
+			tree->numInSubtree += CountDelta;
+			tree->numEnabledInSubtree += EnabledDelta;
+			tree->weightInSubtree += WeightDelta;
+
+			// Keep rounding from leaving weight behind in trees that no longer hold anything enabled
+			if (tree->numEnabledInSubtree == 0)
+				tree->weightInSubtree = 0.0;
+		}
+	}
+
+	/**
+	 * Gets the weight an entry counts for in weighted picks, which is zero while it is disabled
+	 */
+	FORCEINLINE float GetPickWeight(int32 EntryIndex) const
+	{
+		const FEntry &entry = shared->Entries[EntryIndex];
+		return entry.bEnabled ? entry.Weight : 0.f;
+	}
+
+	/**
+	 * Creates a new entry for an actor, reusing a freed one if there is any
+	 *
+	 * @param Act Actor the entry is for
+	 * @returns Index of the entry, which is not stored in any node yet
+	 */
+	int32 AllocateEntry(PayloadType Act)
+	{
+		int32 entryIndex = shared->FirstFreeEntry;
+		if (entryIndex != INDEX_NONE)
+			shared->FirstFreeEntry = shared->Entries[entryIndex].Slot;
+		else
+			entryIndex = shared->Entries.AddUninitialized();
+
+		FEntry &entry = shared->Entries[entryIndex];
+		entry.Payload = Act;
+		entry.Node = NULL;
+		entry.Slot = INDEX_NONE;
+		entry.Serial = shared->NextSerial;
+		entry.Weight = 1.f;
+		entry.bEnabled = true;
+
+		if (++shared->NextSerial == 0)
+			shared->NextSerial = 1;
+
+		shared->PayloadEntries.Add(Act, entryIndex);
+		return entryIndex;
+	}
+
+	/**
+	 * Returns an entry that is no longer stored in any node to the free list, invalidating its handles
+	 *
+	 * @param EntryIndex Entry to free
+	 */
+	void FreeEntry(int32 EntryIndex)
+	{
+		FEntry &entry = shared->Entries[EntryIndex];
+		shared->PayloadEntries.Remove(entry.Payload);
+
+		entry.Payload = PayloadType();
+		entry.Node = NULL;
+		entry.Serial = 0;
+		entry.Slot = shared->FirstFreeEntry;
+		shared->FirstFreeEntry = EntryIndex;
+	}
+
+	/**
+	 * Makes a handle for an entry
+	 *
+	 * @param EntryIndex Entry the handle refers to
+	 * @returns Handle matching the entry's current serial number
+	 */
+	FORCEINLINE FSpatialTreeHandle MakeHandle(int32 EntryIndex) const
+	{
+		FSpatialTreeHandle handle;
+		handle.Index = EntryIndex;
+		handle.Serial = shared->Entries[EntryIndex].Serial;
+		return handle;
+	}
+
+	/**
+	 * Removes an entry from the node it is stored in and collapses the nodes around it
+	 *
+	 * @param EntryIndex Entry to remove
+	 */
+	void RemoveEntry(int32 EntryIndex)
+	{
+		TSpatialTree *node = shared->Entries[EntryIndex].Node;
+		node->RemoveFromData(shared->Entries[EntryIndex].Slot);
+		node->ChangeSubtreeTotals(-1, shared->Entries[EntryIndex].bEnabled ? -1 : 0, -GetPickWeight(EntryIndex));
+		FreeEntry(EntryIndex);
+		node->CollapseUpwards();
+	}
+
+	/**
+	 * Moves an entry to a new position. It stays in its node while the node still owns the position, otherwise it
+	 * climbs to the lowest node that does and is placed again from there. Must be called on the root.
+	 *
+	 * @param EntryIndex Entry to move
+	 * @param NewPosition New position of the entry
+	 * @returns False if the entry moved outside bounds that cannot expand and was removed
+	 */
+	bool MoveEntry(int32 EntryIndex, VectorType NewPosition)
+	{
+		TSpatialTree *node = shared->Entries[EntryIndex].Node;
+		int32 slot = shared->Entries[EntryIndex].Slot;
+		if (node->OwnsPosition(NewPosition))
+		{
+			node->positions.Set(slot, NewPosition);
+			return true;
+		}
+
+		node->RemoveFromData(slot);
+		node->ChangeSubtreeTotals(-1, shared->Entries[EntryIndex].bEnabled ? -1 : 0, -GetPickWeight(EntryIndex));
+
+		TSpatialTree *ancestor = node->parent;
+		while (ancestor != NULL && !ancestor->OwnsPosition(NewPosition))
+			ancestor = ancestor->parent;
+
+		if (ancestor != NULL)
+		{
+			ancestor->Insert(EntryIndex, NewPosition);
+			node->CollapseUpwards();
+			return true;
+		}
+
+		// The entry left the tree entirely. Growing may rebalance the whole tree, so the old node is collapsed first
+		node->CollapseUpwards();
+		if (!bCanExpandBounds)
+		{
+			FreeEntry(EntryIndex);
+			return false;
+		}
+
+		ExpandBounds(NewPosition, minBounds, maxBounds);
+		Insert(EntryIndex, NewPosition);
+		return true;
+	}
+
+	/**
+	 * Fills this tree and creates its children from a range of entries, reordering the range as it goes. The children
+	 * of large ranges near the top of the tree are built as parallel tasks, each carving nodes from a pool of its own
+	 * that is absorbed into the given pool once every task is done.
+	 *
+	 * @param Entries First entry of the range
+	 * @param Num Number of entries in the range
+	 * @param Pool Pool to allocate children from, only used by the calling thread
+	 * @param ParallelLevels Number of levels further down the tree that may still build their children in parallel
+	 */
+	void BuildRecursive(FBuildEntry *Entries, int32 Num, TNodePool<TSpatialTree> &Pool, int32 ParallelLevels)
+	{
+		numInSubtree = Num;
+
+		// This tree keeps the first entries, exactly like Add would
+		int32 numHere = FMath::Min(Num, shared->Policy.LeafCapacity);
+
+		// A tree that is not allowed to split keeps everything that reaches it
+		if (!CanSplit())
+			numHere = Num;
+
+		weightInSubtree = 0.0;
+		for (int32 i = 0; i < numHere; i++)
+		{
+			AddToData(Entries[i].EntryIndex, Entries[i].Position);
+			weightInSubtree += GetPickWeight(Entries[i].EntryIndex);
+		}
+		numEnabledInSubtree = numEnabledInData;
+
+		Entries += numHere;
+		Num -= numHere;
+		if (Num == 0)
+			return;
+
+		// Partition on the last axis, then each part on the axis before it, using the same rules as GetChildIndex.
+		// The ranges end up in child order, so child i covers [rangeStart[i], rangeStart[i + 1])
+		int32 rangeStart[NumChildren + 1];
+		rangeStart[0] = 0;
+		rangeStart[NumChildren] = Num;
+		for (int32 axis = Dim - 1; axis >= 0; axis--)
+		{
+			int32 step = 1 << axis;
+			for (int32 i = 0; i < NumChildren; i += 2 * step)
+			{
+				int32 begin = rangeStart[i];
+				int32 numLower = Algo::Partition(Entries + begin, rangeStart[i + 2 * step] - begin, [this, axis](const FBuildEntry &Entry) { return Entry.Position[axis] <= midPoint[axis]; });
+				rangeStart[i + step] = begin + numLower;
+			}
+		}
+
+		if (ParallelLevels > 0 && Num >= ParallelBuildThreshold)
+		{
+			// Children are created up front so the tasks only ever touch their own subtree
+			for (int32 i = 0; i < NumChildren; i++)
+			{
+				if (rangeStart[i + 1] > rangeStart[i])
+					GetOrCreateChild(i, Pool);
+			}
+
+			TNodePool<TSpatialTree> taskPools[NumChildren];
+			ParallelFor(NumChildren, [&](int32 Index)
+			{
+				if (trees[Index] != NULL)
+					trees[Index]->BuildRecursive(Entries + rangeStart[Index], rangeStart[Index + 1] - rangeStart[Index], taskPools[Index], ParallelLevels - 1);
+			});
+
+			for (TNodePool<TSpatialTree> &taskPool : taskPools)
+				Pool.Absorb(taskPool);
+		}
+		else
+		{
+			for (int32 i = 0; i < NumChildren; i++)
+			{
+				if (rangeStart[i + 1] > rangeStart[i])
+					GetOrCreateChild(i, Pool)->BuildRecursive(Entries + rangeStart[i], rangeStart[i + 1] - rangeStart[i], Pool, 0);
+			}
+		}
+
+		// Weights and enabled counts are only known once every child has been built
+		for (const TSpatialTree *tree : trees)
+		{
+			if (tree != NULL)
+			{
+				numEnabledInSubtree += tree->numEnabledInSubtree;
+				weightInSubtree += tree->weightInSubtree;
+			}
+		}
+	}
+
+	/**
+	 * Gets the midpoint between two points
+	 */
+	VectorType GetMidpoint(VectorType startBounds, VectorType endBounds) const
+	{
+		return (startBounds + endBounds) / 2;
+	}
+
+	/**
+	 * Checks whether a position is inside the tree's boundary, inclusive of its edges
+	 */
+	FORCEINLINE bool IsInBounds(const VectorType &pos) const
+	{
+		for (int32 axis = 0; axis < Dim; axis++)
+		{
+			if (pos[axis] < minBounds[axis] || pos[axis] > maxBounds[axis])
+				return false;
+		}
+		return true;
+	}
+
+	/**
+	 * Gets the child a position belongs to using only the midpoint, with one bit per axis set when the position is
+	 * past the midpoint. Points exactly on the midpoint belong to the lower side.
+	 *
+	 * @params Position Vector to classify, assumed to be inside this tree
+	 * @returns Index of the child on the same side of the midpoint as the position
+	 */
+	FORCEINLINE int32 GetChildIndex(const VectorType &pos) const
+	{
+		int32 index = 0;
+		for (int32 axis = 0; axis < Dim; axis++)
+			index |= (pos[axis] > midPoint[axis] ? 1 : 0) << axis;
+		return index;
+	}
+
+	/**
+	 * Gets whether this tree may hand Actors down to child trees. Trees too deep or too small to split, and trees
+	 * whose bounds no longer split in floating point, keep every Actor that reaches them instead.
+	 *
+	 * @returns True if the split policy allows this tree to split
+	 */
+	FORCEINLINE bool CanSplit() const
+	{
+		VectorType size = maxBounds - minBounds;
+		return midPoint != minBounds && shared->Policy.CanSplit(depth, size.GetMax());
+	}
+
+	/**
+	 * Gets whether a position can be stored in this tree without changing which tree Find reaches it through. The
+	 * root owns its whole boundary. Children leave out their lower edges, which may belong to a neighbour, so
+	 * positions exactly on them are placed again from a parent.
+	 *
+	 * @params Position Vector to test
+	 * @returns True if the position can stay in this tree
+	 */
+	FORCEINLINE bool OwnsPosition(const VectorType &pos) const
+	{
+		if (parent == NULL)
+			return IsInBounds(pos);
+
+		for (int32 axis = 0; axis < Dim; axis++)
+		{
+			if (pos[axis] <= minBounds[axis] || pos[axis] > maxBounds[axis])
+				return false;
+		}
+		return true;
+	}
+
+	/**
+	 * Gets the squared distance from a position to the closest point inside this tree's boundary
+	 *
+	 * @params Position Vector to measure from
+	 * @returns Zero if the position is inside the boundary, otherwise the squared distance to its nearest edge
+	 */
+	FORCEINLINE float GetDistSquaredToBounds(const VectorType &pos) const
+	{
+		float distSquared = 0.f;
+		for (int32 axis = 0; axis < Dim; axis++)
+		{
+			float d = FMath::Max3(minBounds[axis] - pos[axis], 0.f, pos[axis] - maxBounds[axis]);
+			distSquared += d * d;
+		}
+		return distSquared;
+	}
+
+	/**
+	 * Gets the squared distance from a position to the furthest point inside this tree's boundary
+	 *
+	 * @params Position Vector to measure from
+	 * @returns The squared distance to the furthest corner of the boundary
+	 */
+	FORCEINLINE float GetMaxDistSquaredToBounds(const VectorType &pos) const
+	{
+		float distSquared = 0.f;
+		for (int32 axis = 0; axis < Dim; axis++)
+		{
+			float d = FMath::Max(FMath::Abs(pos[axis] - minBounds[axis]), FMath::Abs(pos[axis] - maxBounds[axis]));
+			distSquared += d * d;
+		}
+		return distSquared;
+	}
+
+	/**
+	 * Gets the Morton code of a position quantized over this tree's boundary. Positions outside the boundary are
+	 * clamped to its nearest cell.
+	 *
+	 * @params Position Vector to encode
+	 * @returns The Morton code of the cell the position falls in
+	 */
+	FORCEINLINE uint32 GetMortonCode(const VectorType &pos) const
+	{
+		const int32 numCells = 1 << TSpatialVector<Dim>::MortonBitsPerAxis;
+		uint32 cells[Dim];
+		for (int32 axis = 0; axis < Dim; axis++)
+		{
+			float size = maxBounds[axis] - minBounds[axis];
+			float scaled = size > 0.f ? (pos[axis] - minBounds[axis]) / size * numCells : 0.f;
+			cells[axis] = (uint32)FMath::Clamp(FMath::FloorToInt(scaled), 0, numCells - 1);
+		}
+		return TSpatialVector<Dim>::EncodeMorton(cells);
+	}
+
+	/**
+	 * Checks whether this tree's boundary overlaps a box
+	 */
+	FORCEINLINE bool OverlapsBox(const VectorType &Min, const VectorType &Max) const
+	{
+		for (int32 axis = 0; axis < Dim; axis++)
+		{
+			if (minBounds[axis] > Max[axis] || maxBounds[axis] < Min[axis])
+				return false;
+		}
+		return true;
+	}
+
+	/**
+	 * Checks whether a box fully contains this tree's boundary
+	 */
+	FORCEINLINE bool IsInsideBox(const VectorType &Min, const VectorType &Max) const
+	{
+		for (int32 axis = 0; axis < Dim; axis++)
+		{
+			if (Min[axis] > minBounds[axis] || maxBounds[axis] > Max[axis])
+				return false;
+		}
+		return true;
+	}
+
+	/**
+	 * Visits all actors in this tree and its children that lie inside a box
+	 *
+	 * @returns False if the visitor stopped the query early
+	 */
+	template<typename VisitorType>
+	bool QueryBoxRecursive(const VectorType &Min, const VectorType &Max, VisitorType &Visitor) const
+	{
+		// Skip the per actor test when the whole tree is inside the box
+		bool bContained = IsInsideBox(Min, Max);
+
+		auto visitIndex = [this, &Visitor](int32 Index) { return Visitor(data[Index], positions.Get(Index)); };
+		if (bContained)
+		{
+			for (int i = 0; i < positions.Num(); i++)
+			{
+				if (!visitIndex(i))
+					return false;
+			}
+		}
+		else if (!positions.ForEachInBox(Min, Max, visitIndex))
+		{
+			return false;
+		}
+
+		for (const TSpatialTree *tree : trees)
+		{
+			// Only descend into children that overlap the box
+			if (tree != NULL && tree->OverlapsBox(Min, Max))
+			{
+				if (!tree->QueryBoxRecursive(Min, Max, Visitor))
+					return false;
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * Visits all actors in this tree and its children that lie within a radius of a position
+	 *
+	 * @returns False if the visitor stopped the query early
+	 */
+	template<typename VisitorType>
+	bool QuerySphereRecursive(const VectorType &Center, float RadiusSquared, VisitorType &Visitor) const
+	{
+		// Skip the per actor test when the whole tree is inside the radius
+		bool bContained = GetMaxDistSquaredToBounds(Center) <= RadiusSquared;
+
+		auto visitIndex = [this, &Visitor](int32 Index) { return Visitor(data[Index], positions.Get(Index)); };
+		if (bContained)
+		{
+			for (int i = 0; i < positions.Num(); i++)
+			{
+				if (!visitIndex(i))
+					return false;
+			}
+		}
+		else if (!positions.ForEachInSphere(Center, RadiusSquared, visitIndex))
+		{
+			return false;
+		}
+
+		for (const TSpatialTree *tree : trees)
+		{
+			// Only descend into children that overlap the radius
+			if (tree != NULL && tree->GetDistSquaredToBounds(Center) <= RadiusSquared)
+			{
+				if (!tree->QuerySphereRecursive(Center, RadiusSquared, Visitor))
+					return false;
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * Visits all actors in this tree and its children that are inside a region
+	 *
+	 * @returns False if the visitor stopped the query early
+	 */
+	template<typename RegionType, typename VisitorType>
+	bool QueryRegionRecursive(const RegionType &Region, VisitorType &Visitor) const
+	{
+		ERegionOverlap overlap = Region.Classify(minBounds, maxBounds);
+		if (overlap == ERegionOverlap::Outside)
+			return true;
+
+		for (int32 i = 0; i < positions.Num(); i++)
+		{
+			VectorType position = positions.Get(i);
+			if ((overlap == ERegionOverlap::Inside || Region.Contains(position)) && !Visitor(data[i], position))
+				return false;
+		}
+
+		for (const TSpatialTree *tree : trees)
+		{
+			if (tree != NULL && !tree->QueryRegionRecursive(Region, Visitor))
+				return false;
+		}
+		return true;
+	}
+
+	/**
+	 * Adds up the weight, or the number, of the enabled Actors in this tree and its children that are inside a region.
+	 * Subtrees entirely inside the region are taken from their totals
+	 *
+	 * @param Region Region the Actors must be in
+	 * @param bWeighted Whether weights are added up instead of Actors counted
+	 * @returns The total for the region
+	 */
+	template<typename RegionType>
+	double SumRegionRecursive(const RegionType &Region, bool bWeighted) const
+	{
+		if (numEnabledInSubtree == 0)
+			return 0.0;
+
+		ERegionOverlap overlap = Region.Classify(minBounds, maxBounds);
+		if (overlap == ERegionOverlap::Outside)
+			return 0.0;
+
+		if (overlap == ERegionOverlap::Inside)
+			return bWeighted ? weightInSubtree.Load() : (double)numEnabledInSubtree;
+
+		double total = 0.0;
+		for (int32 i = 0; i < positions.Num(); i++)
+		{
+			if (Region.Contains(positions.Get(i)))
+				total += GetRegionPickWeight(entryIndices[i], bWeighted);
+		}
+
+		for (const TSpatialTree *tree : trees)
+		{
+			if (tree != NULL)
+				total += tree->SumRegionRecursive(Region, bWeighted);
+		}
+		return total;
+	}
+
+	/**
+	 * Walks the enabled Actors inside a region in the same order SumRegionRecursive adds them up, until a running total passes
+	 * the pick's target. The subtree the target lands in is only opened along a single path
+	 *
+	 * @param Region Region the Actors must be in
+	 * @param bWeighted Whether weights are added up instead of Actors counted
+	 * @param Pick Target to walk to, updated with what has been walked past
+	 * @returns True once the target has been reached, with the picked Actor in Pick.Payload
+	 */
+	template<typename RegionType>
+	bool PickInRegionRecursive(const RegionType &Region, bool bWeighted, FRegionPick &Pick) const
+	{
+		if (numEnabledInSubtree == 0)
+			return false;
+
+		ERegionOverlap overlap = Region.Classify(minBounds, maxBounds);
+		if (overlap == ERegionOverlap::Outside)
+			return false;
+
+		if (overlap == ERegionOverlap::Inside)
+		{
+			double subtreeTotal = bWeighted ? weightInSubtree.Load() : (double)numEnabledInSubtree;
+			if (subtreeTotal <= 0.0)
+				return false;
+
+			if (Pick.Target < subtreeTotal)
+			{
+				Pick.Payload = bWeighted ? GetActorAtWeight(Pick.Target) : GetEnabledActorAt(FMath::Min((int32)Pick.Target, (int32)subtreeTotal - 1));
+				return true;
+			}
+
+			Pick.Target -= subtreeTotal;
+			Pick.Tree = this;
+			return false;
+		}
+
+		for (int32 i = 0; i < positions.Num(); i++)
+		{
+			if (!Region.Contains(positions.Get(i)))
+				continue;
+
+			float weight = GetRegionPickWeight(entryIndices[i], bWeighted);
+			if (weight <= 0.f)
+				continue;
+
+			Pick.Payload = data[i];
+			Pick.Tree = NULL;
+			if (Pick.Target < weight)
+				return true;
+
+			Pick.Target -= weight;
+		}
+
+		for (const TSpatialTree *tree : trees)
+		{
+			if (tree != NULL && tree->PickInRegionRecursive(Region, bWeighted, Pick))
+				return true;
+		}
+		return false;
+	}
+
+	/**
+	 * Gets what an entry adds to a region pick's total, its weight or one, or zero while it is disabled
+	 */
+	FORCEINLINE float GetRegionPickWeight(int32 EntryIndex, bool bWeighted) const
+	{
+		return bWeighted ? GetPickWeight(EntryIndex) : (shared->Entries[EntryIndex].bEnabled ? 1.f : 0.f);
+	}
+
+	/**
+	 * Gets an enabled Actor by its index among the enabled Actors, in the order GetAllActors lists them. While SetEnabled
+	 * runs alongside, the totals read on the way down may be out of step, so every step is bounded and nothing is
+	 * returned when the index cannot be placed
+	 *
+	 * @param Index Index of the Actor, from 0 to NumEnabled() - 1
+	 * @returns The Actor at that index, or nothing if it could not be found
+	 */
+	PayloadType GetEnabledActorAt(int32 Index) const
+	{
+		if (Index < 0)
+			return PayloadType();
+
+		const TSpatialTree *tree = this;
+		int32 numInData = tree->numEnabledInData;
+		while (Index >= numInData)
+		{
+			Index -= numInData;
+			const TSpatialTree *next = NULL;
+			for (const TSpatialTree *child : tree->trees)
+			{
+				if (child == NULL)
+					continue;
+
+				int32 numInChild = child->numEnabledInSubtree;
+				if (Index < numInChild)
+				{
+					next = child;
+					break;
+				}
+				Index -= numInChild;
+			}
+
+			if (next == NULL)
+				return PayloadType();
+			tree = next;
+			numInData = tree->numEnabledInData;
+		}
+
+		// Only nodes with some Actors disabled need to be scanned
+		if (numInData == tree->data.Num())
+			return tree->data[Index];
+
+		for (int32 i = 0; i < tree->data.Num(); i++)
+		{
+			if (shared->Entries[tree->entryIndices[i]].bEnabled && Index-- == 0)
+				return tree->data[i];
+		}
+		return PayloadType();
+	}
+
+	/**
+	 * Finds the Actor a running total of weights reaches a target at, walking this tree's data and then each child in
+	 * the same order as GetActorAt
+	 *
+	 * @param Target Weight to walk past, from zero up to the total weight of this tree
+	 * @returns The Actor the target falls on, or nothing if every weight is zero
+	 */
+	PayloadType GetActorAtWeight(double Target) const
+	{
+		const TSpatialTree *tree = this;
+		while (true)
+		{
+			int32 lastWeighted = INDEX_NONE;
+			for (int32 i = 0; i < tree->data.Num(); i++)
+			{
+				float weight = GetPickWeight(tree->entryIndices[i]);
+				if (weight <= 0.f)
+					continue;
+
+				if (Target < weight)
+					return tree->data[i];
+
+				Target -= weight;
+				lastWeighted = i;
+			}
+
+			const TSpatialTree *next = NULL;
+			for (const TSpatialTree *child : tree->trees)
+			{
+				double childWeight = child != NULL ? child->weightInSubtree.Load() : 0.0;
+				if (childWeight <= 0.0)
+					continue;
+
+				next = child;
+				if (Target < childWeight)
+					break;
+
+				Target -= childWeight;
+			}
+
+			// Rounding in the totals can leave the target just past the end, where the last weighted Actor takes it
+			if (next == NULL)
+				return lastWeighted != INDEX_NONE ? tree->data[lastWeighted] : PayloadType();
+
+			tree = next;
+		}
+	}
+
+	/**
+	 * Changes the weight of an entry and the totals of every tree above it
+	 *
+	 * @param EntryIndex Entry to change
+	 * @param Weight New weight, clamped to zero or more
+	 */
+	void SetEntryWeight(int32 EntryIndex, float Weight)
+	{
+		FEntry &entry = shared->Entries[EntryIndex];
+		Weight = FMath::Max(Weight, 0.f);
+		if (entry.Node != NULL && entry.bEnabled)
+			entry.Node->ChangeSubtreeTotals(0, 0, (double)Weight - entry.Weight);
+		entry.Weight = Weight;
+	}
+
+	/**
+	 * Changes whether an entry is enabled and the totals of every tree above it
+	 *
+	 * @param EntryIndex Entry to change
+	 * @param bEnabled Whether the entry can be returned by nearest and random queries
+	 */
+	void SetEntryEnabled(int32 EntryIndex, bool bEnabled)
+	{
+		FEntry &entry = shared->Entries[EntryIndex];
+		if (entry.bEnabled == bEnabled)
+			return;
+
+		if (entry.Node != NULL)
+		{
+			entry.Node->numEnabledInData += bEnabled ? 1 : -1;
+			entry.Node->ChangeSubtreeTotals(0, bEnabled ? 1 : -1, bEnabled ? entry.Weight : -entry.Weight);
+		}
+		entry.bEnabled = bEnabled;
+	}
+
+	/**
+	 * Appends every Actor in this tree and its children in pre-order
+	 *
+	 * @param OutActors List the Actors are appended to
+	 */
+	void Traverse(TArray<PayloadType> &OutActors) const
+	{
+		OutActors.Append(data);
+
+		for (const TSpatialTree *tree : trees)
+		{
+			if (tree != NULL)
+				tree->Traverse(OutActors);
+		}
+	}
+
+	/**
+	 * Traverses the tree in pre-order and pops all values out of it until the tree is completely cleared
+	 *
+	 * @param OutEntries List the entry of each popped Actor is appended to
+	 * @param OutPositions List the cached position of each popped Actor is appended to
+	 */
+	void TraverseAndPop(TArray<int32> &OutEntries, TArray<VectorType> &OutPositions)
+	{
+		OutEntries.Append(entryIndices);
+		positions.AppendTo(OutPositions);
+		data.Empty();
+		positions.Empty();
+		entryIndices.Empty();
+		numEnabledInData = 0;
+
+		for (TSpatialTree *tree : trees)
+		{
+			if (tree != NULL)
+				tree->TraverseAndPop(OutEntries, OutPositions);
+		}
+	}
+
+	/**
+	 * Recursively sets the bounds of the given tree and all of its child trees
+	 *
+	 * @param Min Smallest corner of the boundary
+	 * @param Max Largest corner of the boundary
+	 */
+	void SetBoundsRecursively(VectorType Min, VectorType Max)
+	{
+		this->minBounds = Min;
+		this->maxBounds = Max;
+		this->midPoint = GetMidpoint(Min, Max);
+
+		for (int i = 0; i < NumChildren; i++)
+		{
+			if (trees[i] == NULL)
+				continue;
+
+			VectorType childMin, childMax;
+			GetChildBounds(i, Min, Max, childMin, childMax);
+			trees[i]->SetBoundsRecursively(childMin, childMax);
+		}
+	}
+
+	/**
+	 * Pops all of the Actors in the tree and builds it again from them in one pass to rebalance it
+	 */
+	void Rebalance()
+	{
+		TArray<int32> allEntries;
+		TArray<VectorType> allPositions;
+		this->TraverseAndPop(allEntries, allPositions);
+
+		// Hand every child back to the pool so the rebuilt tree reuses the same memory
+		FreeChildren();
+
+		TArray<FBuildEntry> entries;
+		entries.Reserve(allEntries.Num());
+		for (int i = 0; i < allEntries.Num(); i++)
+		{
+			// Entries keep their handles, only those left outside bounds that cannot expand are dropped. The tree is
+			// empty here, so expanding only stretches the bounds and never rebalances again
+			if (!IsInBounds(allPositions[i]))
+			{
+				if (!bCanExpandBounds)
+				{
+					FreeEntry(allEntries[i]);
+					continue;
+				}
+
+				ExpandBounds(allPositions[i], minBounds, maxBounds);
+			}
+
+			entries.Add(FBuildEntry{ allEntries[i], allPositions[i] });
+		}
+
+		BuildRecursive(entries.GetData(), entries.Num(), shared->Pool, ParallelBuildLevels);
+	}
+
+	/*
+	 * Expands the boundaries of the tree until they contain a position. The tree doubles in size towards the position
+	 * and keeps everything it already holds as one child of the bigger tree, so no Actor is reinserted.
+	 *
+	 * @param Position The position of the point to expand relative to
+	 * @param Min Smallest corner of this tree
+	 * @param Max Largest corner of this tree
+	 */
+	void ExpandBounds(VectorType Position, VectorType Min, VectorType Max)
+	{
+		if (!bCanExpandBounds)
+			return;
+
+		// A tree that is flat along any axis cannot be doubled, so stretch it to the point instead. This happens when
+		// every Actor so far shares a line or a plane, and it is free for an empty tree
+		bool bFlat = data.Num() == 0 && !HasChildren();
+		for (int32 axis = 0; axis < Dim; axis++)
+			bFlat |= Min[axis] >= Max[axis];
+
+		if (bFlat)
+		{
+			for (int32 axis = 0; axis < Dim; axis++)
+			{
+				Min[axis] = FMath::Min(Min[axis], Position[axis]);
+				Max[axis] = FMath::Max(Max[axis], Position[axis]);
+			}
+
+			this->SetBounds(Min, Max);
+			return;
+		}
+
+		while (!IsInBounds(Position))
+			GrowTowards(Position);
+	}
+
+	/*
+	 * Doubles the size of the tree towards a position, moving its current contents into a child that keeps the
+	 * current bounds
+	 *
+	 * @param Position The position to grow towards
+	 */
+	void GrowTowards(VectorType Position)
+	{
+		VectorType oldMin = minBounds;
+		VectorType oldMax = maxBounds;
+		VectorType size = oldMax - oldMin;
+
+		// Wrap everything this tree holds in a child with the old bounds and split
+		TSpatialTree *oldRoot = shared->Pool.Allocate(oldMin, oldMax, this);
+		oldRoot->midPoint = midPoint;
+		oldRoot->numInSubtree = numInSubtree;
+		oldRoot->numEnabledInSubtree = numEnabledInSubtree;
+		oldRoot->weightInSubtree = weightInSubtree;
+		oldRoot->numEnabledInData = numEnabledInData;
+		numEnabledInData = 0;
+		Swap(oldRoot->data, data);
+		Swap(oldRoot->positions, positions);
+		Swap(oldRoot->entryIndices, entryIndices);
+		for (int32 entryIndex : oldRoot->entryIndices)
+			shared->Entries[entryIndex].Node = oldRoot;
+
+		for (int i = 0; i < NumChildren; i++)
+		{
+			oldRoot->trees[i] = trees[i];
+			if (trees[i] != NULL)
+			{
+				trees[i]->parent = oldRoot;
+				trees[i]->IncreaseDepth();
+			}
+			trees[i] = NULL;
+		}
+
+		// Split exactly on the old edges so every existing point still lands in the wrapped child. Points on a split
+		// belong to the lower side, so when growing towards smaller values the split sits on the float just before
+		// the old edge. The old tree sits on the opposite side of the split from the direction of growth
+		int32 oldRootIndex = 0;
+		for (int32 axis = 0; axis < Dim; axis++)
+		{
+			if (Position[axis] < oldMin[axis])
+			{
+				minBounds[axis] = oldMin[axis] - size[axis];
+				midPoint[axis] = nextafterf(oldMin[axis], -MAX_FLT);
+				oldRootIndex |= 1 << axis;
+			}
+			else
+			{
+				maxBounds[axis] = oldMax[axis] + size[axis];
+				midPoint[axis] = oldMax[axis];
+			}
+		}
+
+		trees[oldRootIndex] = oldRoot;
+	}
+
+	/*
+	 * Moves this tree and all of its children one level deeper, for when a new root is placed above them
+	 */
+	void IncreaseDepth()
+	{
+		depth++;
+		for (TSpatialTree *tree : trees)
+		{
+			if (tree != NULL)
+				tree->IncreaseDepth();
+		}
+	}
+
+private:
+	/** Ranges of at least this many entries have their children built on worker threads */
+	static const int32 ParallelBuildThreshold = 8192;
+
+	/** Number of levels below the root whose children may be built on worker threads */
+	static const int32 ParallelBuildLevels = 2;
+
+	/** Written at the start of every buffer Save writes */
+	static const uint32 SavedMagic = 0x45455254;
+
+	/** Version of the layout Save writes. Bump it whenever the layout changes so older buffers are rejected */
+	static const uint32 FormatVersion = 1;
+
+	/** Boundary points for the node */
+	VectorType minBounds;
+	VectorType maxBounds;
+
+	/** Point the node is split at, normally halfway between its boundary points */
+	VectorType midPoint;
+
+	/** Data stored in this tree */
+	TArray<PayloadType> data;
+
+	/** Cached position of each Actor in data, stored at the same index with one aligned array per axis */
+	TLeafCoords<Dim, VectorType> positions;
+
+	/** Entry of each Actor in data, stored at the same index */
+	TArray<int32> entryIndices;
+
+	/** Node pool, split policy and entries shared by every node in the tree, owned by the root */
+	FSharedState *shared;
+
+	/** Whether this tree created the shared state and must delete it */
+	bool bOwnsShared;
+
+	/** Tree this tree is a child of, or NULL for the root */
+	TSpatialTree *parent;
+
+	/** Level of this tree, where the root is level 0 */
+	int32 depth;
+
+	/** Number of Actors in this tree and all of its children */
+	int32 numInSubtree;
+
+	/** Number of enabled Actors in this tree and all of its children. The enabled totals are atomic so SetEnabled can run while readers query */
+	TRelaxedAtomic<int32> numEnabledInSubtree;
+
+	/** Number of enabled Actors in this tree's own data */
+	TRelaxedAtomic<int32> numEnabledInData;
+
+	/** Total weight of the enabled Actors in this tree and all of its children */
+	TRelaxedAtomic<double> weightInSubtree;
+
+	/** Child nodes, indexed by one bit per axis */
+	TSpatialTree *trees[NumChildren];
+};
@@ -8,7 +8,7 @@ ASpawnPoint::ASpawnPoint()
 {
  	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
 	PrimaryActorTick.bCanEverTick = true;
-
+	SpawnWeight = 1.f;
 }
 
 // Called when the game starts or when spawned
@@ -26,3 +26,8 @@ void ASpawnPoint::Tick(float DeltaTime)
 
 }
 
+float ASpawnPoint::GetSpawnWeight(const AActor *SpawnPoint)
+{
+	const ASpawnPoint *asSpawnPoint = Cast<ASpawnPoint>(SpawnPoint);
+	return asSpawnPoint ? FMath::Max(asSpawnPoint->SpawnWeight, 0.f) : 1.f;
+}
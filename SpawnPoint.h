@@ -23,6 +23,15 @@ public:
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
 
-	
-	
+	/**
+	 * Gets how likely an actor is to be picked by weighted random spawns
+	 *
+	 * @param SpawnPoint Actor used as a spawn point
+	 * @returns The SpawnWeight of a spawn point, or 1 for any other actor
+	 */
+	static float GetSpawnWeight(const AActor *SpawnPoint);
+
+	/** How likely this spawn point is to be picked by random spawns, relative to the other spawn points. Read when the spawner begins play */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Spawning", meta = (ClampMin = "0"))
+	float SpawnWeight;
 };
@@ -3,31 +3,56 @@
 #include "Spawner.h"
 #include "Helpers.h"
 #include "QTree.h"
+#include "LinearQTree.h"
+#include "LooseQTree.h"
+#include "OctTree.h"
 #include "SpawnPoint.h"
 #include "Runtime/Engine/Classes/GameFramework/Actor.h"
 #include "Runtime/Engine/Classes/Engine/World.h"
 #include "Runtime/Engine/Classes/Kismet/GameplayStatics.h"
 #include "Runtime/Engine/Public/EngineUtils.h"
+#include "HAL/PlatformTime.h"
+#include "Stats/Stats.h"
+#include "Async/Async.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
 
+DECLARE_STATS_GROUP(TEXT("Spawner"), STATGROUP_Spawner, STATCAT_Advanced);
+DECLARE_CYCLE_STAT(TEXT("Process Spawn Queue"), STAT_ProcessSpawnQueue, STATGROUP_Spawner);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Queued Spawns"), STAT_QueuedSpawns, STATGROUP_Spawner);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Queued Spawns Handled"), STAT_QueuedSpawnsHandled, STATGROUP_Spawner);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Max Queued Spawn Latency (ms)"), STAT_QueuedSpawnMaxLatency, STATGROUP_Spawner);
 
 // Sets default values
 ASpawner::ASpawner()
 {
 	PrimaryActorTick.bCanEverTick = true;
 	bAutoAddAllSpawnPoints = true;
-	tree = new QTree();
-	tree->bCanExpandBounds = true;
+	SpawnPointIndex = ESpawnPointIndex::QuadTree;
+	LeafCapacity = 16;
+	MaxTreeDepth = 16;
+	MinCellSize = 1.f;
+	bUseBakedSpawnIndex = false;
+	tree = MakeUnique<TSpatialSnapshot<QTree>>();
+	linearTree = MakeUnique<TSpatialSnapshot<LinearQTree>>();
+	octTree = MakeUnique<TSpatialSnapshot<OctTree>>();
+	noSpawnZones = MakeUnique<LooseQTree>();
+	MaxQueuedSpawnsPerFrame = 16;
+	QueuedSpawnBudgetMs = 2.f;
+	SpawnPointCooldown = 0.f;
+	nextSpawnRequestId = 0;
+	lastCooldownSlot = 0;
 }
 
 
 AActor* ASpawner::SpawnAtNearestLocation(FVector2D Location, TSubclassOf<AActor> ActorToSpawn)
 {
 	AActor *spawnedAct = NULL;
-	AActor *nearestSpawnPoint = tree->FindNearest(Location);
+	AActor *nearestSpawnPoint = FindNearestOpenSpawnPoint(GetLocationAtSpawnerHeight(Location));
 	FActorSpawnParameters params;
 
 	if (nearestSpawnPoint)
-		spawnedAct = GetWorld()->SpawnActorAbsolute(ActorToSpawn, nearestSpawnPoint->GetActorTransform(), params);
+		spawnedAct = AcquireActor(ActorToSpawn, nearestSpawnPoint, params);
 	else
 		UE_LOG(LogTemp, Error, TEXT("No spawn point in tree found"));
 
@@ -35,61 +60,215 @@ AActor* ASpawner::SpawnAtNearestLocation(FVector2D Location, TSubclassOf<AActor>
 }
 
 void ASpawner::SpawnAtNearestLocation(FVector2D Location, TSubclassOf<AActor> ActorToSpawn, AActor* &SpawnedActor_out, ESpawnActorCollisionHandlingMethod SpawnMethod)
+{
+	SpawnAtNearestLocation3D(GetLocationAtSpawnerHeight(Location), ActorToSpawn, SpawnedActor_out, SpawnMethod);
+}
+
+void ASpawner::SpawnAtNearestLocation3D(FVector Location, TSubclassOf<AActor> ActorToSpawn, AActor* &SpawnedActor_out, ESpawnActorCollisionHandlingMethod SpawnMethod)
 {
 	AActor *spawnedAct = NULL;
-	AActor *nearestSpawnPoint = tree->FindNearest(Location);
+	AActor *nearestSpawnPoint = FindNearestOpenSpawnPoint(Location);
 	FActorSpawnParameters params;
 
 	params.SpawnCollisionHandlingOverride = SpawnMethod;
 
 	if (nearestSpawnPoint)
-		spawnedAct = GetWorld()->SpawnActorAbsolute(ActorToSpawn, nearestSpawnPoint->GetActorTransform(), params);
+		spawnedAct = AcquireActor(ActorToSpawn, nearestSpawnPoint, params);
 	else
 		UE_LOG(LogTemp, Error, TEXT("No spawn point in tree found"));
 
 	SpawnedActor_out = spawnedAct;
 }
+
+void ASpawner::SpawnAtNearestLocations(const TArray<FVector2D> &Locations, TSubclassOf<AActor> ActorToSpawn, TArray<AActor*> &SpawnedActors_out, ESpawnActorCollisionHandlingMethod SpawnMethod)
+{
+	TArray<FVector> locations;
+	locations.Reserve(Locations.Num());
+	for (const FVector2D &location : Locations)
+		locations.Add(GetLocationAtSpawnerHeight(location));
+
+	TArray<AActor *> nearestSpawnPoints;
+	nearestSpawnPoints.SetNumZeroed(locations.Num());
+	FindNearestSpawnPoints(locations, nearestSpawnPoints);
+
+	// Search again around the few locations whose nearest spawn point is blocked
+	for (int32 i = 0; i < locations.Num(); i++)
+	{
+		if (nearestSpawnPoints[i] && !IsSpawnPointOpen(nearestSpawnPoints[i]))
+			nearestSpawnPoints[i] = FindNearestOpenSpawnPoint(locations[i]);
+	}
+
+	FActorSpawnParameters params;
+	params.SpawnCollisionHandlingOverride = SpawnMethod;
+
+	SpawnedActors_out.Reset(locations.Num());
+	for (AActor *nearestSpawnPoint : nearestSpawnPoints)
+	{
+		AActor *spawnedAct = NULL;
+		if (nearestSpawnPoint)
+			spawnedAct = AcquireActor(ActorToSpawn, nearestSpawnPoint, params);
+		else
+			UE_LOG(LogTemp, Error, TEXT("No spawn point in tree found"));
+
+		SpawnedActors_out.Add(spawnedAct);
+	}
+}
+
+void ASpawner::SpawnBatchAtNearestLocations(FVector2D Location, TSubclassOf<AActor> ActorToSpawn, int32 Count, TArray<AActor*> &SpawnedActors_out, ESpawnActorCollisionHandlingMethod SpawnMethod)
+{
+	SpawnedActors_out.Reset(FMath::Max(Count, 0));
+	if (Count <= 0)
+		return;
+
+	TArray<AActor *> batchSpawnPoints;
+	batchSpawnPoints.SetNumZeroed(Count);
+	int32 numReserved = ReserveNearestSpawnPoints(GetLocationAtSpawnerHeight(Location), batchSpawnPoints);
+	if (numReserved < Count)
+		UE_LOG(LogTemp, Warning, TEXT("Only %d of %d spawn points were free to reserve"), numReserved, Count);
+
+	FActorSpawnParameters params;
+	params.SpawnCollisionHandlingOverride = SpawnMethod;
+
+	for (int32 i = 0; i < numReserved; i++)
+	{
+		// Each actor holds its spawn point until it is released or destroyed. A failed spawn holds nothing
+		AActor *spawnedAct = AcquireActor(ActorToSpawn, batchSpawnPoints[i], params);
+		if (spawnedAct)
+			HoldSpawnPoint(spawnedAct, batchSpawnPoints[i]);
+		else
+			ReleaseSpawnPoint(batchSpawnPoints[i]);
+
+		SpawnedActors_out.Add(spawnedAct);
+	}
+}
+
+int32 ASpawner::QueueSpawnAtNearestLocation(FVector2D Location, TSubclassOf<AActor> ActorToSpawn, ESpawnActorCollisionHandlingMethod SpawnMethod)
+{
+	FQueuedSpawn request;
+	request.RequestId = nextSpawnRequestId++;
+	request.Location = GetLocationAtSpawnerHeight(Location);
+	request.ActorToSpawn = ActorToSpawn;
+	request.SpawnMethod = SpawnMethod;
+	request.QueueTime = FPlatformTime::Seconds();
+	spawnQueue.Add(request);
+	return request.RequestId;
+}
+
+int32 ASpawner::GetNumQueuedSpawns() const
+{
+	return spawnQueue.Num();
+}
+
+void ASpawner::ReleaseActor(AActor *SpawnedActor)
+{
+	if (!SpawnedActor)
+		return;
+
+	ReleaseHeldSpawnPoint(SpawnedActor);
+	if (SpawnedActor->IsActorBeingDestroyed())
+		return;
+
+	FSpawnPool *pool = actorPools.Find(SpawnedActor->GetClass());
+	if (!pool || pool->InactiveActors.Num() >= pool->MaxPooledActors)
+	{
+		SpawnedActor->Destroy();
+		return;
+	}
+
+	SpawnedActor->SetActorHiddenInGame(true);
+	SpawnedActor->SetActorEnableCollision(false);
+	SpawnedActor->SetActorTickEnabled(false);
+	pool->InactiveActors.Add(SpawnedActor);
+}
+
+void ASpawner::HoldSpawnPoint(AActor *SpawnedActor, AActor *SpawnPoint)
+{
+	{
+		FScopeLock lock(&reservationLock);
+		const int32 *spawnPointIndex = spawnPointIndices.Find(SpawnPoint);
+		if (!spawnPointIndex)
+			return;
+
+		spawnPointHolders[*spawnPointIndex] = SpawnedActor;
+	}
+
+	heldSpawnPoints.Add(SpawnedActor, SpawnPoint);
+	SpawnedActor->OnDestroyed.AddUniqueDynamic(this, &ASpawner::OnHolderDestroyed);
+}
+
+void ASpawner::ReleaseHeldSpawnPoint(AActor *SpawnedActor)
+{
+	AActor *spawnPoint = NULL;
+	if (!heldSpawnPoints.RemoveAndCopyValue(SpawnedActor, spawnPoint))
+		return;
+
+	SpawnedActor->OnDestroyed.RemoveDynamic(this, &ASpawner::OnHolderDestroyed);
+
+	// A spawn point released by hand may have been reserved by another batch since, which must keep it
+	FScopeLock lock(&reservationLock);
+	const int32 *spawnPointIndex = spawnPointIndices.Find(spawnPoint);
+	if (spawnPointIndex && spawnPointHolders[*spawnPointIndex] == SpawnedActor)
+	{
+		reservedSpawnPoints[*spawnPointIndex] = false;
+		spawnPointHolders[*spawnPointIndex] = NULL;
+		SyncSpawnPointEnabled(*spawnPointIndex);
+	}
+}
+
+void ASpawner::OnHolderDestroyed(AActor *DestroyedActor)
+{
+	ReleaseHeldSpawnPoint(DestroyedActor);
+}
+
 AActor* ASpawner::SpawnAtRandomLocation(TSubclassOf<AActor> ActorToSpawn)
 {
 	AActor *spawnedAct = NULL;
-	TArray<AActor *> AllSpawnPoints = tree->GetAllActors();
+	AActor *randomSpawnPoint = PickRandomOpenSpawnPoint();
 
-	if (AllSpawnPoints.Num() < 1)
+	if (!randomSpawnPoint)
 	{
 		UE_LOG(LogTemp, Error, TEXT("No spawn point in tree found"));
 		return NULL;
 	}
 
-
-	int size = AllSpawnPoints.Num();
-	int randIndex = FMath::RandRange(0, size - 1);
-
 	FActorSpawnParameters params;
 
-	spawnedAct = GetWorld()->SpawnActorAbsolute(ActorToSpawn, AllSpawnPoints[randIndex]->GetActorTransform(), params);
+	spawnedAct = AcquireActor(ActorToSpawn, randomSpawnPoint, params);
 
 	return spawnedAct;
 }
 void ASpawner::SpawnAtRandomLocation(TSubclassOf<AActor> ActorToSpawn, AActor* &SpawnedActor_out, ESpawnActorCollisionHandlingMethod SpawnMethod)
 {
 	AActor *spawnedAct = NULL;
-	TArray<AActor *> AllSpawnPoints = tree->GetAllActors();
+	AActor *randomSpawnPoint = PickRandomOpenSpawnPoint();
 
-	if (AllSpawnPoints.Num() < 1)
+	if (!randomSpawnPoint)
 	{
 		UE_LOG(LogTemp, Error, TEXT("No spawn point in tree found"));
 		SpawnedActor_out = NULL;
 		return;
 	}
 
+	FActorSpawnParameters params;
+	params.SpawnCollisionHandlingOverride = SpawnMethod;
 
-	int size = AllSpawnPoints.Num();
-	int randIndex = FMath::RandRange(0, size - 1);
+	spawnedAct = AcquireActor(ActorToSpawn, randomSpawnPoint, params);
 
+	SpawnedActor_out = spawnedAct;
+}
+
+void ASpawner::SpawnAtRandomLocationInRegion(FVector2D Center, float Radius, FVector2D ExcludeCenter, float ExcludeRadius, TSubclassOf<AActor> ActorToSpawn, AActor* &SpawnedActor_out, ESpawnActorCollisionHandlingMethod SpawnMethod)
+{
+	AActor *spawnedAct = NULL;
+	AActor *randomSpawnPoint = PickRandomOpenSpawnPointInRegion(Center, Radius, ExcludeCenter, ExcludeRadius);
 	FActorSpawnParameters params;
+
 	params.SpawnCollisionHandlingOverride = SpawnMethod;
 
-	spawnedAct = GetWorld()->SpawnActorAbsolute(ActorToSpawn, AllSpawnPoints[randIndex]->GetActorTransform(), params);
+	if (randomSpawnPoint)
+		spawnedAct = AcquireActor(ActorToSpawn, randomSpawnPoint, params);
+	else
+		UE_LOG(LogTemp, Error, TEXT("No spawn point in region found"));
 
 	SpawnedActor_out = spawnedAct;
 }
@@ -97,25 +276,983 @@ void ASpawner::SpawnAtRandomLocation(TSubclassOf<AActor> ActorToSpawn, AActor* &
 // Called when the game starts or when spawned
 void ASpawner::BeginPlay()
 {
-	// Only add custom spawn points if the list is filled
-	if(SpawnPoints.Num() > 0)
-		tree->Add(SpawnPoints);
+	// Load the baked index when there is one, which skips both searching the level and building the index
+	TArray<AActor *> allSpawnPoints;
+	if (bUseBakedSpawnIndex && LoadBakedSpawnIndex(allSpawnPoints))
+	{
+		UpdateSpawnPointState(allSpawnPoints);
+		ValidateBakedSpawnIndex(allSpawnPoints);
+	}
+	else
+	{
+		if (bUseBakedSpawnIndex)
+			UE_LOG(LogTemp, Warning, TEXT("Baked spawn index of %s is missing or out of date, building it instead"), *GetName());
+
+		allSpawnPoints = GatherSpawnPoints();
+		UpdateSpawnPointState(allSpawnPoints);
+		BuildSpawnIndex(allSpawnPoints);
+	}
+
+	// The cooldown wheel starts turning from now
+	lastCooldownSlot = FMath::FloorToInt(GetWorld()->GetTimeSeconds() / CooldownSlotSeconds);
+
+	// Index the no spawn zones by their bounds so each spawn only has to check the zones around it
+	noSpawnZones->Build(NoSpawnZones.FilterByPredicate([](AActor *Zone) { return Zone != NULL; }));
+
+	PrewarmPools();
+
+	Super::BeginPlay();
+}
+
+TArray<AActor*> ASpawner::GatherSpawnPoints() const
+{
+	// Start from the manually added spawn points. A spawn point listed twice, or also found in the level, is only kept
+	// once, so it can never be handed to two spawns of one batch
+	TArray<AActor *> allSpawnPoints;
+	TSet<AActor *> seen;
+	for (AActor *spawnPoint : SpawnPoints)
+	{
+		if (spawnPoint == NULL || seen.Contains(spawnPoint))
+			continue;
+
+		seen.Add(spawnPoint);
+		allSpawnPoints.Add(spawnPoint);
+	}
 
 	// Add all spawn points placed in level
 	if (bAutoAddAllSpawnPoints)
 	{
 		for (TActorIterator<ASpawnPoint> actItr(GetWorld()); actItr; ++actItr)
 		{
-			tree->Add(*actItr);
+			if (!seen.Contains(*actItr))
+				allSpawnPoints.Add(*actItr);
 		}
 	}
 
-	Super::BeginPlay();
+	return allSpawnPoints;
+}
+
+void ASpawner::UpdateSpawnPointState(const TArray<AActor*> &AllSpawnPoints)
+{
+	// Give every spawn point a bit in the reservation and cooldown sets. Spawn points that already had bits keep their
+	// reservation and cooldown, new ones start open. Everything is swapped under the lock, so no reader sees the new
+	// map with the old bits
+	TMap<AActor *, int32> newIndices;
+	TBitArray<> newReserved;
+	TBitArray<> newCooling;
+	TArray<float> newEndTimes;
+	TArray<AActor *> newHolders;
+	TArray<AActor *> newSpawnPoints;
+	newIndices.Reserve(AllSpawnPoints.Num());
+	newEndTimes.Reserve(AllSpawnPoints.Num());
+	newHolders.Reserve(AllSpawnPoints.Num());
+	newSpawnPoints.Reserve(AllSpawnPoints.Num());
+
+	FScopeLock lock(&reservationLock);
+	for (AActor *spawnPoint : AllSpawnPoints)
+	{
+		if (newIndices.Contains(spawnPoint))
+			continue;
+
+		const int32 *oldIndex = spawnPointIndices.Find(spawnPoint);
+		newIndices.Add(spawnPoint, newIndices.Num());
+		newReserved.Add(oldIndex && reservedSpawnPoints[*oldIndex]);
+		newCooling.Add(oldIndex && coolingSpawnPoints[*oldIndex]);
+		newEndTimes.Add(oldIndex ? cooldownEndTimes[*oldIndex] : 0.f);
+		newHolders.Add(oldIndex ? spawnPointHolders[*oldIndex] : NULL);
+		newSpawnPoints.Add(spawnPoint);
+	}
+
+	spawnPointIndices = MoveTemp(newIndices);
+	reservedSpawnPoints = MoveTemp(newReserved);
+	coolingSpawnPoints = MoveTemp(newCooling);
+	cooldownEndTimes = MoveTemp(newEndTimes);
+	spawnPointHolders = MoveTemp(newHolders);
+	indexedSpawnPoints = MoveTemp(newSpawnPoints);
+}
+
+/**
+ * Builds a new spatial index of spawn points without publishing it. The pointer trees also store each spawn point's weight
+ *
+ * @param SpawnPoints Spawn points to put in the index
+ * @param SplitPolicy When the index's nodes split
+ *
+ * @returns The index, owned by the caller
+ */
+template<typename TreeType>
+static TreeType* NewSpawnIndex(const TArray<AActor*> &SpawnPoints, const FSplitPolicy &SplitPolicy)
+{
+	TArray<float> spawnWeights;
+	spawnWeights.Reserve(SpawnPoints.Num());
+	for (AActor *spawnPoint : SpawnPoints)
+		spawnWeights.Add(ASpawnPoint::GetSpawnWeight(spawnPoint));
+
+	TreeType *built = new TreeType();
+	built->SetSplitPolicy(SplitPolicy);
+	built->Build(SpawnPoints, spawnWeights);
+	return built;
+}
+
+template<>
+LinearQTree* NewSpawnIndex<LinearQTree>(const TArray<AActor*> &SpawnPoints, const FSplitPolicy &SplitPolicy)
+{
+	// The linear tree keeps no weights, VisitSpawnPointsInRegion reads them from the spawn points instead
+	LinearQTree *built = new LinearQTree();
+	built->SetSplitPolicy(SplitPolicy);
+	built->Build(SpawnPoints);
+	return built;
+}
+
+void ASpawner::SyncSpawnPointEnabled(int32 StateIndex)
+{
+	AActor *spawnPoint = indexedSpawnPoints[StateIndex];
+	bool bOpen = !reservedSpawnPoints[StateIndex] && !coolingSpawnPoints[StateIndex];
+	if (SpawnPointIndex == ESpawnPointIndex::OctTree)
+		octTree->ModifyInPlace([spawnPoint, bOpen](OctTree &Published) { Published.SetEnabled(spawnPoint, bOpen); });
+	else if (SpawnPointIndex == ESpawnPointIndex::QuadTree)
+		tree->ModifyInPlace([spawnPoint, bOpen](QTree &Published) { Published.SetEnabled(spawnPoint, bOpen); });
+}
+
+void ASpawner::BuildSpawnIndex(const TArray<AActor*> &AllSpawnPoints)
+{
+	// Bulk load every spawn point at once into a private copy, then publish it for every thread to query
+	FSplitPolicy splitPolicy(LeafCapacity, MaxTreeDepth, MinCellSize);
+	if (SpawnPointIndex == ESpawnPointIndex::LinearQuadTree)
+	{
+		linearTree->Publish(NewSpawnIndex<LinearQTree>(AllSpawnPoints, splitPolicy));
+		return;
+	}
+
+	// Closed spawn points are disabled before the copy is published, under the lock so none open or close in between
+	auto disableClosed = [this](auto &Built)
+	{
+		for (int32 i = 0; i < indexedSpawnPoints.Num(); i++)
+		{
+			if (reservedSpawnPoints[i] || coolingSpawnPoints[i])
+				Built.SetEnabled(indexedSpawnPoints[i], false);
+		}
+	};
+
+	if (SpawnPointIndex == ESpawnPointIndex::OctTree)
+	{
+		OctTree *built = NewSpawnIndex<OctTree>(AllSpawnPoints, splitPolicy);
+		FScopeLock lock(&reservationLock);
+		disableClosed(*built);
+		octTree->Publish(built);
+	}
+	else
+	{
+		QTree *built = NewSpawnIndex<QTree>(AllSpawnPoints, splitPolicy);
+		FScopeLock lock(&reservationLock);
+		disableClosed(*built);
+		tree->Publish(built);
+	}
+}
+
+void ASpawner::RebuildSpawnIndex()
+{
+	TArray<AActor *> allSpawnPoints = GatherSpawnPoints();
+	UpdateSpawnPointState(allSpawnPoints);
+	BuildSpawnIndex(allSpawnPoints);
+}
+
+bool ASpawner::LoadBakedSpawnIndex(TArray<AActor*> &OutSpawnPoints)
+{
+	if (BakedSpawnIndex.Num() == 0)
+		return false;
+
+	OutSpawnPoints.Reset(BakedSpawnPoints.Num());
+	for (const TSoftObjectPtr<AActor> &bakedSpawnPoint : BakedSpawnPoints)
+	{
+		AActor *spawnPoint = bakedSpawnPoint.Get();
+		if (spawnPoint == NULL)
+			return false;
+
+		OutSpawnPoints.Add(spawnPoint);
+	}
+
+	FMemoryReader reader(BakedSpawnIndex);
+	uint32 magic = 0, version = 0;
+	uint8 indexType = 0;
+	reader << magic << version << indexType;
+	if (reader.IsError() || magic != BakedSpawnIndexMagic || version != BakedSpawnIndexVersion || indexType != (uint8)SpawnPointIndex)
+		return false;
+
+	// A bake made with other split settings no longer matches the index the spawner asks for
+	auto matchesSettings = [this](const FSplitPolicy &Policy)
+	{
+		return Policy.LeafCapacity == LeafCapacity && Policy.MaxDepth == MaxTreeDepth && Policy.MinCellSize == MinCellSize;
+	};
+
+	if (SpawnPointIndex == ESpawnPointIndex::LinearQuadTree)
+	{
+		LinearQTree *loaded = new LinearQTree();
+		if (!loaded->Load(reader, OutSpawnPoints) || !matchesSettings(loaded->GetSplitPolicy()))
+		{
+			delete loaded;
+			return false;
+		}
+		linearTree->Publish(loaded);
+	}
+	else if (SpawnPointIndex == ESpawnPointIndex::OctTree)
+	{
+		OctTree *loaded = new OctTree();
+		if (!loaded->Load(reader, OutSpawnPoints) || !matchesSettings(loaded->GetSplitPolicy()))
+		{
+			delete loaded;
+			return false;
+		}
+		octTree->Publish(loaded);
+	}
+	else
+	{
+		QTree *loaded = new QTree();
+		if (!loaded->Load(reader, OutSpawnPoints) || !matchesSettings(loaded->GetSplitPolicy()))
+		{
+			delete loaded;
+			return false;
+		}
+		tree->Publish(loaded);
+	}
+	return true;
+}
+
+/**
+ * Checks that a spatial index stores every spawn point near where it is
+ *
+ * @param Tree Index to check
+ * @param SpawnPoints Spawn points to look for
+ * @param Locations Location of each spawn point, at the same index
+ * @param Tolerance Distance a spawn point may be from its stored position
+ *
+ * @returns True if every spawn point was found
+ */
+template<int32 Dim, typename TreeType>
+static bool StoresSpawnPointsAt(const TreeType &Tree, const TArray<AActor*> &SpawnPoints, const TArray<FVector> &Locations, float Tolerance)
+{
+	typedef typename TSpatialVector<Dim>::Type VectorType;
+
+	for (int32 i = 0; i < SpawnPoints.Num(); i++)
+	{
+		// The visitor stops the query as soon as it finds the spawn point, so finding it makes the query return false
+		AActor *spawnPoint = SpawnPoints[i];
+		bool bMissing = Tree.QueryRadius(TSpatialVector<Dim>::FromLocation(Locations[i]), Tolerance, [spawnPoint](AActor *Act, const VectorType &Position)
+		{
+			return Act != spawnPoint;
+		});
+
+		if (bMissing)
+			return false;
+	}
+	return true;
+}
+
+void ASpawner::ValidateBakedSpawnIndex(const TArray<AActor*> &BakedActors)
+{
+	// Which spawn points there are is cheap to compare exactly, so that is done here. The baked list holds each spawn
+	// point once, so the two match when the level has every baked spawn point and no others
+	TArray<AActor *> liveSpawnPoints = GatherSpawnPoints();
+	TSet<AActor *> liveSet(liveSpawnPoints);
+	bool bSameSpawnPoints = liveSet.Num() == BakedActors.Num();
+	for (int32 i = 0; bSameSpawnPoints && i < BakedActors.Num(); i++)
+		bSameSpawnPoints = liveSet.Contains(BakedActors[i]);
+
+	// Rebuilding now happens before anything has been spawned, so no reservation or cooldown is in play yet
+	if (!bSameSpawnPoints)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Baked spawn index of %s does not hold the spawn points in the level, rebuilding it"), *GetName());
+		RebuildSpawnIndex();
+		return;
+	}
+
+	// Only where the spawn points are is left to check, which means a search per spawn point, so it runs on a worker
+	// thread. Actors can only be read on the game thread, so their locations are taken here
+	TArray<FVector> liveLocations;
+	liveLocations.Reserve(liveSpawnPoints.Num());
+	for (AActor *spawnPoint : liveSpawnPoints)
+		liveLocations.Add(spawnPoint->GetActorLocation());
+
+	// The check loads its own copy of the bake, so it never touches the spawner if the spawner goes away first
+	TWeakObjectPtr<ASpawner> weakThis(this);
+	ESpawnPointIndex indexType = SpawnPointIndex;
+	Async(EAsyncExecution::ThreadPool, [weakThis, indexType, bakedIndex = BakedSpawnIndex, BakedActors, liveSpawnPoints = MoveTemp(liveSpawnPoints), liveLocations = MoveTemp(liveLocations)]()
+	{
+		FMemoryReader reader(bakedIndex);
+		uint32 magic = 0, version = 0;
+		uint8 savedIndexType = 0;
+		reader << magic << version << savedIndexType;
+
+		bool bMatches;
+		if (indexType == ESpawnPointIndex::LinearQuadTree)
+		{
+			LinearQTree baked;
+			bMatches = baked.Load(reader, BakedActors) && StoresSpawnPointsAt<2>(baked, liveSpawnPoints, liveLocations, BakedPositionTolerance);
+		}
+		else if (indexType == ESpawnPointIndex::OctTree)
+		{
+			OctTree baked;
+			bMatches = baked.Load(reader, BakedActors) && StoresSpawnPointsAt<3>(baked, liveSpawnPoints, liveLocations, BakedPositionTolerance);
+		}
+		else
+		{
+			QTree baked;
+			bMatches = baked.Load(reader, BakedActors) && StoresSpawnPointsAt<2>(baked, liveSpawnPoints, liveLocations, BakedPositionTolerance);
+		}
+
+		if (!bMatches)
+		{
+			AsyncTask(ENamedThreads::GameThread, [weakThis]()
+			{
+				if (ASpawner *spawner = weakThis.Get())
+				{
+					UE_LOG(LogTemp, Warning, TEXT("Baked spawn index of %s has spawn points where the level does not, rebuilding it"), *spawner->GetName());
+					spawner->RebuildSpawnIndex();
+				}
+			});
+		}
+	});
+}
+
+#if WITH_EDITOR
+void ASpawner::BakeSpawnIndex()
+{
+	BakedSpawnPoints.Reset();
+	BakedSpawnIndex.Reset();
+
+	// Build the index exactly as play would, but into a copy of its own, so saving never changes the live index or
+	// drops reservations and cooldowns while the spawner is in use
+	TArray<AActor *> allSpawnPoints = GatherSpawnPoints();
+	FSplitPolicy splitPolicy(LeafCapacity, MaxTreeDepth, MinCellSize);
+
+	FMemoryWriter writer(BakedSpawnIndex);
+	uint32 magic = BakedSpawnIndexMagic, version = BakedSpawnIndexVersion;
+	uint8 indexType = (uint8)SpawnPointIndex;
+	writer << magic << version << indexType;
+
+	TArray<AActor *> bakedActors;
+	bool bSaved = true;
+	if (SpawnPointIndex == ESpawnPointIndex::LinearQuadTree)
+	{
+		// Number each spawn point by its place in the baked list, which is how the linear index refers to it
+		TMap<AActor *, int32> bakedIndices;
+		for (AActor *spawnPoint : allSpawnPoints)
+		{
+			if (!bakedIndices.Contains(spawnPoint))
+			{
+				bakedIndices.Add(spawnPoint, bakedActors.Num());
+				bakedActors.Add(spawnPoint);
+			}
+		}
+
+		TUniquePtr<LinearQTree> baked(NewSpawnIndex<LinearQTree>(allSpawnPoints, splitPolicy));
+		bSaved = baked->Save(writer, bakedIndices);
+	}
+	else if (SpawnPointIndex == ESpawnPointIndex::OctTree)
+	{
+		// The pointer trees hand back the spawn point of each of their entries, which is how they refer to them
+		TUniquePtr<OctTree> baked(NewSpawnIndex<OctTree>(allSpawnPoints, splitPolicy));
+		baked->Save(writer, bakedActors);
+	}
+	else
+	{
+		TUniquePtr<QTree> baked(NewSpawnIndex<QTree>(allSpawnPoints, splitPolicy));
+		baked->Save(writer, bakedActors);
+	}
+
+	if (!bSaved || writer.IsError())
+	{
+		BakedSpawnIndex.Reset();
+		return;
+	}
+
+	BakedSpawnPoints.Reserve(bakedActors.Num());
+	for (AActor *spawnPoint : bakedActors)
+		BakedSpawnPoints.Add(spawnPoint);
+}
+
+void ASpawner::PreSave(const ITargetPlatform *TargetPlatform)
+{
+	Super::PreSave(TargetPlatform);
+
+	// Defaults and archetypes have no level of their own to bake, and game worlds are never saved as levels. Either way
+	// the bake already stored is left alone
+	UWorld *world = GetWorld();
+	if (HasAnyFlags(RF_ClassDefaultObject | RF_ArchetypeObject) || world == NULL || world->IsGameWorld())
+		return;
+
+	if (bUseBakedSpawnIndex)
+	{
+		BakeSpawnIndex();
+	}
+	else
+	{
+		BakedSpawnPoints.Empty();
+		BakedSpawnIndex.Empty();
+	}
 }
+#endif
 
 TArray<AActor*> ASpawner::GetAllSpawnPoints()
 {
-	return tree->GetAllActors();
+	if (SpawnPointIndex == ESpawnPointIndex::LinearQuadTree)
+	{
+		TSpatialSnapshot<LinearQTree>::FReadScope published(*linearTree);
+		return published ? published->GetAllActors() : TArray<AActor*>();
+	}
+	else if (SpawnPointIndex == ESpawnPointIndex::OctTree)
+	{
+		TSpatialSnapshot<OctTree>::FReadScope published(*octTree);
+		return published ? published->GetAllActors() : TArray<AActor*>();
+	}
+
+	TSpatialSnapshot<QTree>::FReadScope published(*tree);
+	return published ? published->GetAllActors() : TArray<AActor*>();
+}
+
+TArray<AActor*> ASpawner::GetSpawnPointsInRadius(FVector2D Location, float Radius)
+{
+	TArray<AActor *> spawnPointsInRadius;
+	auto addSpawnPoint = [&spawnPointsInRadius](AActor *SpawnPoint, const FVector2D &Position)
+	{
+		spawnPointsInRadius.Add(SpawnPoint);
+		return true;
+	};
+
+	if (SpawnPointIndex == ESpawnPointIndex::LinearQuadTree)
+	{
+		TSpatialSnapshot<LinearQTree>::FReadScope published(*linearTree);
+		if (published)
+			published->QueryRadius(Location, Radius, addSpawnPoint);
+	}
+	else if (SpawnPointIndex == ESpawnPointIndex::OctTree)
+	{
+		TSpatialSnapshot<OctTree>::FReadScope published(*octTree);
+		if (!published)
+			return spawnPointsInRadius;
+
+		// Search a box covering every height, then keep the spawn points inside the circle
+		float radiusSquared = FMath::Square(Radius);
+		published->QueryBox(FVector(Location.X - Radius, Location.Y - Radius, -MAX_FLT), FVector(Location.X + Radius, Location.Y + Radius, MAX_FLT),
+			[&](AActor *SpawnPoint, const FVector &Position)
+			{
+				if (FVector2D::DistSquared(Location, FVector2D(Position.X, Position.Y)) <= radiusSquared)
+					spawnPointsInRadius.Add(SpawnPoint);
+				return true;
+			});
+	}
+	else
+	{
+		TSpatialSnapshot<QTree>::FReadScope published(*tree);
+		if (published)
+			published->QueryRadius(Location, Radius, addSpawnPoint);
+	}
+	return spawnPointsInRadius;
+}
+
+AActor* ASpawner::FindNearestSpawnPoint(FVector Location) const
+{
+	AActor *nearestSpawnPoint = NULL;
+	if (SpawnPointIndex == ESpawnPointIndex::LinearQuadTree)
+	{
+		TSpatialSnapshot<LinearQTree>::FReadScope published(*linearTree);
+		if (published)
+			published->FindKNearest(FVector2D(Location.X, Location.Y), 1, MAX_FLT, MakeArrayView(&nearestSpawnPoint, 1));
+	}
+	else if (SpawnPointIndex == ESpawnPointIndex::OctTree)
+	{
+		TSpatialSnapshot<OctTree>::FReadScope published(*octTree);
+		if (published)
+			published->FindKNearest(Location, 1, MAX_FLT, MakeArrayView(&nearestSpawnPoint, 1));
+	}
+	else
+	{
+		TSpatialSnapshot<QTree>::FReadScope published(*tree);
+		if (published)
+			published->FindKNearest(FVector2D(Location.X, Location.Y), 1, MAX_FLT, MakeArrayView(&nearestSpawnPoint, 1));
+	}
+	return nearestSpawnPoint;
+}
+
+void ASpawner::FindNearestSpawnPoints(TArrayView<const FVector> Locations, TArrayView<AActor*> OutNearest) const
+{
+	for (AActor *&nearestSpawnPoint : OutNearest)
+		nearestSpawnPoint = NULL;
+
+	if (SpawnPointIndex == ESpawnPointIndex::OctTree)
+	{
+		TSpatialSnapshot<OctTree>::FReadScope published(*octTree);
+		if (published)
+			published->FindNearestBatch(Locations, OutNearest);
+		return;
+	}
+
+	// The quad tree indexes search in 2D
+	TArray<FVector2D> flatLocations;
+	flatLocations.SetNumUninitialized(Locations.Num());
+	for (int32 i = 0; i < Locations.Num(); i++)
+		flatLocations[i] = FVector2D(Locations[i].X, Locations[i].Y);
+
+	if (SpawnPointIndex == ESpawnPointIndex::LinearQuadTree)
+	{
+		TSpatialSnapshot<LinearQTree>::FReadScope published(*linearTree);
+		if (published)
+			published->FindNearestBatch(flatLocations, OutNearest);
+	}
+	else
+	{
+		TSpatialSnapshot<QTree>::FReadScope published(*tree);
+		if (published)
+			published->FindNearestBatch(flatLocations, OutNearest);
+	}
+}
+
+bool ASpawner::IsInNoSpawnZone(FVector Location) const
+{
+	return noSpawnZones->AnyContains(FVector2D(Location.X, Location.Y));
+}
+
+void ASpawner::AddNoSpawnZone(AActor *Zone)
+{
+	if (Zone)
+		noSpawnZones->Add(Zone);
+}
+
+void ASpawner::RemoveNoSpawnZone(AActor *Zone)
+{
+	noSpawnZones->Remove(Zone);
+}
+
+bool ASpawner::IsSpawnPointReserved(AActor *SpawnPoint) const
+{
+	FScopeLock lock(&reservationLock);
+	const int32 *spawnPointIndex = spawnPointIndices.Find(SpawnPoint);
+	if (!spawnPointIndex)
+		return false;
+
+	return reservedSpawnPoints[*spawnPointIndex];
+}
+
+void ASpawner::ReleaseSpawnPoint(AActor *SpawnPoint)
+{
+	FScopeLock lock(&reservationLock);
+	const int32 *spawnPointIndex = spawnPointIndices.Find(SpawnPoint);
+	if (!spawnPointIndex)
+		return;
+
+	reservedSpawnPoints[*spawnPointIndex] = false;
+	spawnPointHolders[*spawnPointIndex] = NULL;
+	SyncSpawnPointEnabled(*spawnPointIndex);
+}
+
+void ASpawner::ReleaseAllSpawnPoints()
+{
+	FScopeLock lock(&reservationLock);
+	for (int32 i = 0; i < reservedSpawnPoints.Num(); i++)
+	{
+		if (!reservedSpawnPoints[i])
+			continue;
+
+		reservedSpawnPoints[i] = false;
+		SyncSpawnPointEnabled(i);
+	}
+	spawnPointHolders.Init(NULL, spawnPointIndices.Num());
+}
+
+void ASpawner::StartSpawnPointCooldown(AActor *SpawnPoint, float Duration)
+{
+	if (Duration <= 0.f)
+		return;
+
+	float endTime = GetWorld()->GetTimeSeconds() + Duration;
+	{
+		FScopeLock lock(&reservationLock);
+		const int32 *spawnPointIndex = spawnPointIndices.Find(SpawnPoint);
+		if (!spawnPointIndex || endTime <= cooldownEndTimes[*spawnPointIndex])
+			return;
+
+		cooldownEndTimes[*spawnPointIndex] = endTime;
+		if (!coolingSpawnPoints[*spawnPointIndex])
+		{
+			coolingSpawnPoints[*spawnPointIndex] = true;
+			SyncSpawnPointEnabled(*spawnPointIndex);
+		}
+	}
+
+	int32 endSlot = FMath::FloorToInt(endTime / CooldownSlotSeconds);
+	cooldownWheel[endSlot % NumCooldownSlots].Add(FSpawnPointCooldown{ SpawnPoint, endTime });
+}
+
+bool ASpawner::IsSpawnPointCoolingDown(AActor *SpawnPoint) const
+{
+	FScopeLock lock(&reservationLock);
+	const int32 *spawnPointIndex = spawnPointIndices.Find(SpawnPoint);
+	if (!spawnPointIndex)
+		return false;
+
+	return coolingSpawnPoints[*spawnPointIndex];
+}
+
+void ASpawner::ExpireCooldowns()
+{
+	float now = GetWorld()->GetTimeSeconds();
+	int32 nowSlot = FMath::FloorToInt(now / CooldownSlotSeconds);
+
+	// The slot the last call stopped in may still hold cooldowns, so it is checked again. After a long pause every
+	// slot comes due, but each only needs checking once
+	int32 lastSlot = FMath::Min(nowSlot, lastCooldownSlot + NumCooldownSlots - 1);
+	FScopeLock lock(&reservationLock);
+	for (int32 slotIndex = lastCooldownSlot; slotIndex <= lastSlot; slotIndex++)
+	{
+		TArray<FSpawnPointCooldown> &slot = cooldownWheel[slotIndex % NumCooldownSlots];
+		for (int32 i = slot.Num() - 1; i >= 0; i--)
+		{
+			// Cooldowns due on a later turn of the wheel stay where they are
+			const FSpawnPointCooldown &cooldown = slot[i];
+			if (cooldown.EndTime > now)
+				continue;
+
+			// A cooldown that was extended has a later entry of its own and is left to that one. Spawn points dropped by
+			// a rebuild have nothing left to reopen
+			const int32 *spawnPointIndex = spawnPointIndices.Find(cooldown.SpawnPoint);
+			if (spawnPointIndex && cooldownEndTimes[*spawnPointIndex] <= now && coolingSpawnPoints[*spawnPointIndex])
+			{
+				coolingSpawnPoints[*spawnPointIndex] = false;
+				SyncSpawnPointEnabled(*spawnPointIndex);
+			}
+			slot.RemoveAtSwap(i, 1, false);
+		}
+	}
+	lastCooldownSlot = nowSlot;
+}
+
+bool ASpawner::IsSpawnPointOpen(AActor *SpawnPoint) const
+{
+	return !IsSpawnPointReserved(SpawnPoint) && !IsSpawnPointCoolingDown(SpawnPoint) && !IsInNoSpawnZone(SpawnPoint->GetActorLocation());
+}
+
+int32 ASpawner::ReserveNearestSpawnPoints(FVector Location, TArrayView<AActor*> OutReserved)
+{
+	// Searching and reserving happen under one lock, so two batches can never be handed the same spawn point
+	FScopeLock lock(&reservationLock);
+	int32 numReserved = FindNearestOpenSpawnPoints(Location, OutReserved);
+	for (int32 i = 0; i < numReserved; i++)
+	{
+		int32 stateIndex = spawnPointIndices[OutReserved[i]];
+		reservedSpawnPoints[stateIndex] = true;
+		SyncSpawnPointEnabled(stateIndex);
+	}
+	return numReserved;
+}
+
+AActor* ASpawner::FindNearestOpenSpawnPoint(FVector Location) const
+{
+	AActor *nearestSpawnPoint = FindNearestSpawnPoint(Location);
+	if (!nearestSpawnPoint || IsSpawnPointOpen(nearestSpawnPoint))
+		return nearestSpawnPoint;
+
+	// The nearest spawn point is blocked, so search again skipping every closed one
+	FindNearestOpenSpawnPoints(Location, MakeArrayView(&nearestSpawnPoint, 1));
+	return nearestSpawnPoint;
+}
+
+int32 ASpawner::FindNearestOpenSpawnPoints(FVector Location, TArrayView<AActor*> OutNearest) const
+{
+	// Closed spawn points are skipped inside the search, so a single search finds as many open ones as there are. The
+	// quad and oct trees have every reserved or cooling spawn point disabled, so they skip whole subtrees with nothing
+	// open and only the no spawn zones are left to filter. The linear tree filters on the bits, under the lock so they
+	// cannot change halfway through the search
+	auto outsideZones = [this](AActor *SpawnPoint) { return !IsInNoSpawnZone(SpawnPoint->GetActorLocation()); };
+
+	int32 numOpen = 0;
+	if (SpawnPointIndex == ESpawnPointIndex::LinearQuadTree)
+	{
+		FScopeLock lock(&reservationLock);
+		auto isOpen = [this](AActor *SpawnPoint) { return IsSpawnPointOpen(SpawnPoint); };
+		TSpatialSnapshot<LinearQTree>::FReadScope published(*linearTree);
+		if (published)
+			numOpen = published->FindKNearest(FVector2D(Location.X, Location.Y), OutNearest.Num(), MAX_FLT, OutNearest, isOpen);
+	}
+	else if (SpawnPointIndex == ESpawnPointIndex::OctTree)
+	{
+		TSpatialSnapshot<OctTree>::FReadScope published(*octTree);
+		if (published)
+			numOpen = published->FindKNearest(Location, OutNearest.Num(), MAX_FLT, OutNearest, outsideZones);
+	}
+	else
+	{
+		TSpatialSnapshot<QTree>::FReadScope published(*tree);
+		if (published)
+			numOpen = published->FindKNearest(FVector2D(Location.X, Location.Y), OutNearest.Num(), MAX_FLT, OutNearest, outsideZones);
+	}
+
+	for (int32 i = numOpen; i < OutNearest.Num(); i++)
+		OutNearest[i] = NULL;
+	return numOpen;
+}
+
+AActor* ASpawner::GetRandomSpawnPoint() const
+{
+	if (SpawnPointIndex == ESpawnPointIndex::LinearQuadTree)
+	{
+		TSpatialSnapshot<LinearQTree>::FReadScope published(*linearTree);
+		return published ? published->GetRandomActor() : NULL;
+	}
+	else if (SpawnPointIndex == ESpawnPointIndex::OctTree)
+	{
+		TSpatialSnapshot<OctTree>::FReadScope published(*octTree);
+		return published ? published->GetRandomActor() : NULL;
+	}
+
+	TSpatialSnapshot<QTree>::FReadScope published(*tree);
+	return published ? published->GetRandomActor() : NULL;
+}
+
+AActor* ASpawner::PickRandomOpenSpawnPoint()
+{
+	// The quad and oct trees only draw from open spawn points, so a miss means a no spawn zone, or a spawn point closed
+	// since the draw. The linear tree draws from every spawn point and relies on the retries alone
+	AActor *lastDrawn = NULL;
+	for (int32 attempt = 0; attempt < MaxRandomPickAttempts; attempt++)
+	{
+		AActor *randomSpawnPoint = GetRandomSpawnPoint();
+		if (!randomSpawnPoint)
+			continue;
+
+		if (IsSpawnPointOpen(randomSpawnPoint))
+			return randomSpawnPoint;
+		lastDrawn = randomSpawnPoint;
+	}
+
+	// Nearly everything left is blocked, so settle for the open spawn point nearest the last one drawn
+	return lastDrawn ? FindNearestOpenSpawnPoint(lastDrawn->GetActorLocation()) : NULL;
+}
+
+template<typename VisitorType>
+void ASpawner::VisitSpawnPointsInRegion(FVector2D Center, float Radius, FVector2D ExcludeCenter, float ExcludeRadius, VisitorType &&Visitor) const
+{
+	if (SpawnPointIndex == ESpawnPointIndex::LinearQuadTree)
+	{
+		TSpatialSnapshot<LinearQTree>::FReadScope published(*linearTree);
+		if (!published)
+			return;
+
+		float excludeRadiusSquared = ExcludeRadius > 0.f ? FMath::Square(ExcludeRadius) : 0.f;
+		published->QueryRadius(Center, Radius, [&](AActor *SpawnPoint, const FVector2D &Position)
+		{
+			return FVector2D::DistSquared(Position, ExcludeCenter) < excludeRadiusSquared || Visitor(SpawnPoint, ASpawnPoint::GetSpawnWeight(SpawnPoint));
+		});
+	}
+	else if (SpawnPointIndex == ESpawnPointIndex::OctTree)
+	{
+		// Only X and Y are tested, so the region covers every height
+		TSpatialRegion<FVector, 2> region = TSpatialRegion<FVector, 2>::Sphere(FVector(Center, 0.f), Radius);
+		region.Exclude(FVector(ExcludeCenter, 0.f), ExcludeRadius);
+
+		TSpatialSnapshot<OctTree>::FReadScope published(*octTree);
+		if (published)
+			published->QueryRegion(region, [&](AActor *SpawnPoint, const FVector &Position) { return Visitor(SpawnPoint, published->GetWeight(SpawnPoint)); });
+	}
+	else
+	{
+		TSpatialRegion<FVector2D, 2> region = TSpatialRegion<FVector2D, 2>::Sphere(Center, Radius);
+		region.Exclude(ExcludeCenter, ExcludeRadius);
+
+		TSpatialSnapshot<QTree>::FReadScope published(*tree);
+		if (published)
+			published->QueryRegion(region, [&](AActor *SpawnPoint, const FVector2D &Position) { return Visitor(SpawnPoint, published->GetWeight(SpawnPoint)); });
+	}
+}
+
+template<typename FilterType>
+AActor* ASpawner::PickWeightedSpawnPointInRegion(FVector2D Center, float Radius, FVector2D ExcludeCenter, float ExcludeRadius, FilterType &&Filter) const
+{
+	float totalWeight = 0.f;
+	VisitSpawnPointsInRegion(Center, Radius, ExcludeCenter, ExcludeRadius, [&](AActor *SpawnPoint, float Weight)
+	{
+		if (Weight > 0.f && Filter(SpawnPoint))
+			totalWeight += Weight;
+		return true;
+	});
+
+	AActor *randomSpawnPoint = NULL;
+	float target = FMath::FRand() * totalWeight;
+	VisitSpawnPointsInRegion(Center, Radius, ExcludeCenter, ExcludeRadius, [&](AActor *SpawnPoint, float Weight)
+	{
+		if (Weight <= 0.f || !Filter(SpawnPoint))
+			return true;
+
+		randomSpawnPoint = SpawnPoint;
+		target -= Weight;
+		return target >= 0.f;
+	});
+	return randomSpawnPoint;
+}
+
+AActor* ASpawner::GetRandomSpawnPointInRegion(FVector2D Center, float Radius, FVector2D ExcludeCenter, float ExcludeRadius) const
+{
+	// The linear tree keeps no weight totals, so the spawn points in the area are added up and walked one by one
+	if (SpawnPointIndex == ESpawnPointIndex::LinearQuadTree)
+		return PickWeightedSpawnPointInRegion(Center, Radius, ExcludeCenter, ExcludeRadius, [](AActor *SpawnPoint) { return true; });
+	else if (SpawnPointIndex == ESpawnPointIndex::OctTree)
+	{
+		// Only X and Y are tested, so the region covers every height
+		TSpatialRegion<FVector, 2> region = TSpatialRegion<FVector, 2>::Sphere(FVector(Center, 0.f), Radius);
+		region.Exclude(FVector(ExcludeCenter, 0.f), ExcludeRadius);
+
+		TSpatialSnapshot<OctTree>::FReadScope published(*octTree);
+		return published ? published->GetRandomActorInRegion(region) : NULL;
+	}
+
+	TSpatialRegion<FVector2D, 2> region = TSpatialRegion<FVector2D, 2>::Sphere(Center, Radius);
+	region.Exclude(ExcludeCenter, ExcludeRadius);
+
+	TSpatialSnapshot<QTree>::FReadScope published(*tree);
+	return published ? published->GetRandomActorInRegion(region) : NULL;
+}
+
+AActor* ASpawner::PickRandomOpenSpawnPointInRegion(FVector2D Center, float Radius, FVector2D ExcludeCenter, float ExcludeRadius)
+{
+	for (int32 attempt = 0; attempt < MaxRandomPickAttempts; attempt++)
+	{
+		AActor *randomSpawnPoint = GetRandomSpawnPointInRegion(Center, Radius, ExcludeCenter, ExcludeRadius);
+		if (!randomSpawnPoint || IsSpawnPointOpen(randomSpawnPoint))
+			return randomSpawnPoint;
+	}
+
+	// Most of the area is blocked, so weigh up every open spawn point in it from the index instead. The lock keeps
+	// reservations and cooldowns the same for both passes
+	FScopeLock lock(&reservationLock);
+	return PickWeightedSpawnPointInRegion(Center, Radius, ExcludeCenter, ExcludeRadius, [this](AActor *SpawnPoint) { return IsSpawnPointOpen(SpawnPoint); });
+}
+
+FVector ASpawner::GetLocationAtSpawnerHeight(FVector2D Location) const
+{
+	return FVector(Location.X, Location.Y, GetActorLocation().Z);
+}
+
+AActor* ASpawner::AcquireActor(TSubclassOf<AActor> ActorToSpawn, AActor *SpawnPoint, const FActorSpawnParameters &Params)
+{
+	AActor *spawnedAct = NULL;
+	FSpawnPool *pool = actorPools.Find(ActorToSpawn.Get());
+	while (!spawnedAct && pool && pool->InactiveActors.Num() > 0)
+	{
+		// Pooled actors can still be destroyed by something else while they wait
+		AActor *pooledAct = pool->InactiveActors.Pop(false);
+		if (!IsValid(pooledAct) || pooledAct->IsActorBeingDestroyed())
+			continue;
+
+		pooledAct->SetActorTransform(SpawnPoint->GetActorTransform(), false, NULL, ETeleportType::ResetPhysics);
+		pooledAct->SetActorHiddenInGame(false);
+		pooledAct->SetActorEnableCollision(true);
+		pooledAct->SetActorTickEnabled(true);
+		spawnedAct = pooledAct;
+	}
+
+	if (!spawnedAct)
+		spawnedAct = GetWorld()->SpawnActorAbsolute(ActorToSpawn, SpawnPoint->GetActorTransform(), Params);
+
+	if (spawnedAct && SpawnPointCooldown > 0.f)
+		StartSpawnPointCooldown(SpawnPoint, SpawnPointCooldown);
+
+	return spawnedAct;
+}
+
+void ASpawner::PrewarmPools()
+{
+	FActorSpawnParameters params;
+	params.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	actorPools.Reset();
+	for (const FSpawnPoolSettings &settings : PooledClasses)
+	{
+		if (!settings.ActorClass)
+			continue;
+
+		FSpawnPool &pool = actorPools.FindOrAdd(settings.ActorClass.Get());
+		pool.MaxPooledActors = FMath::Max(pool.MaxPooledActors, settings.MaxPooledActors);
+
+		int32 numToSpawn = FMath::Min(settings.PrewarmCount, pool.MaxPooledActors) - pool.InactiveActors.Num();
+		for (int32 i = 0; i < numToSpawn; i++)
+		{
+			AActor *pooledAct = GetWorld()->SpawnActorAbsolute(settings.ActorClass, GetActorTransform(), params);
+			if (!pooledAct)
+				break;
+
+			pooledAct->SetActorHiddenInGame(true);
+			pooledAct->SetActorEnableCollision(false);
+			pooledAct->SetActorTickEnabled(false);
+			pool.InactiveActors.Add(pooledAct);
+		}
+	}
+}
+
+void ASpawner::ProcessSpawnQueue()
+{
+	SCOPE_CYCLE_COUNTER(STAT_ProcessSpawnQueue);
+
+	int32 numHandled = 0;
+	float maxLatencyMs = 0.f;
+	if (spawnQueue.Num() > 0)
+	{
+		double startTime = FPlatformTime::Seconds();
+		double endTime = QueuedSpawnBudgetMs > 0.f ? startTime + QueuedSpawnBudgetMs / 1000.0 : MAX_dbl;
+		int32 maxHandled = MaxQueuedSpawnsPerFrame > 0 ? FMath::Min(MaxQueuedSpawnsPerFrame, spawnQueue.Num()) : spawnQueue.Num();
+
+		// Without a count limit the nearest spawn points are found a chunk at a time, so a long queue under a time
+		// budget does not search for requests the frame never reaches
+		int32 chunkSize = MaxQueuedSpawnsPerFrame > 0 ? maxHandled : FMath::Min(QueuedSpawnChunkSize, maxHandled);
+		TArray<FVector> locations;
+		TArray<AActor *> nearestSpawnPoints;
+		FActorSpawnParameters params;
+		bool bOutOfTime = false;
+		while (numHandled < maxHandled && !bOutOfTime)
+		{
+			// Find the nearest spawn point for the whole chunk of requests at once
+			int32 chunkStart = numHandled;
+			int32 chunkEnd = FMath::Min(chunkStart + chunkSize, maxHandled);
+			locations.SetNumUninitialized(chunkEnd - chunkStart, false);
+			for (int32 i = chunkStart; i < chunkEnd; i++)
+				locations[i - chunkStart] = spawnQueue[i].Location;
+
+			nearestSpawnPoints.SetNumZeroed(chunkEnd - chunkStart, false);
+			FindNearestSpawnPoints(locations, nearestSpawnPoints);
+
+			while (numHandled < chunkEnd)
+			{
+				// Copied, since a completion callback may queue another spawn and move the queue
+				FQueuedSpawn request = spawnQueue[numHandled];
+				AActor *nearestSpawnPoint = nearestSpawnPoints[numHandled - chunkStart];
+				numHandled++;
+
+				// Spawns earlier this frame or zones added since may have blocked the spawn point found for this one
+				if (nearestSpawnPoint && !IsSpawnPointOpen(nearestSpawnPoint))
+					nearestSpawnPoint = FindNearestOpenSpawnPoint(request.Location);
+
+				AActor *spawnedAct = NULL;
+				params.SpawnCollisionHandlingOverride = request.SpawnMethod;
+				if (nearestSpawnPoint)
+					spawnedAct = AcquireActor(request.ActorToSpawn, nearestSpawnPoint, params);
+				else
+					UE_LOG(LogTemp, Error, TEXT("No spawn point in tree found"));
+
+				double now = FPlatformTime::Seconds();
+				maxLatencyMs = FMath::Max(maxLatencyMs, (float)((now - request.QueueTime) * 1000.0));
+				OnQueuedSpawnComplete.Broadcast(request.RequestId, spawnedAct);
+
+				if (now >= endTime)
+				{
+					bOutOfTime = true;
+					break;
+				}
+			}
+		}
+
+		spawnQueue.RemoveAt(0, numHandled, false);
+	}
+
+	SET_DWORD_STAT(STAT_QueuedSpawns, spawnQueue.Num());
+	SET_DWORD_STAT(STAT_QueuedSpawnsHandled, numHandled);
+	SET_FLOAT_STAT(STAT_QueuedSpawnMaxLatency, maxLatencyMs);
 }
 
 // Called every frame
@@ -123,5 +1260,7 @@ void ASpawner::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
 
+	ExpireCooldowns();
+	ProcessSpawnQueue();
 }
 
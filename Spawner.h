@@ -4,8 +4,76 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "QTree.h"
+#include "OctTree.h"
+#include "LinearQTree.h"
+#include "LooseQTree.h"
+#include "SpatialSnapshot.h"
+#include "Templates/UniquePtr.h"
+#include "HAL/CriticalSection.h"
 #include "Spawner.generated.h"
 
+/**
+ * Spatial index the spawner stores its spawn points in
+ */
+UENUM(BlueprintType)
+enum class ESpawnPointIndex : uint8
+{
+	/** Pointer based quad tree, cheap to add to and remove from */
+	QuadTree UMETA(DisplayName = "Quad Tree"),
+
+	/** Flat Morton ordered quad tree, fastest to build and query for large sets of spawn points that never change */
+	LinearQuadTree UMETA(DisplayName = "Linear Quad Tree"),
+
+	/** Pointer based oct tree that keeps height, for levels with spawn points stacked on top of each other */
+	OctTree UMETA(DisplayName = "Oct Tree")
+};
+
+/**
+ * Called when a queued spawn request has been handled
+ *
+ * @param RequestId Id returned when the spawn was queued
+ * @param SpawnedActor Spawned actor, or NULL if no spawn point was found
+ */
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnQueuedSpawnComplete, int32, RequestId, AActor*, SpawnedActor);
+
+/**
+ * Pooling options for one spawned class
+ */
+USTRUCT(BlueprintType)
+struct FSpawnPoolSettings
+{
+	GENERATED_BODY()
+
+	/** Class whose actors are pooled */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Pooling")
+	TSubclassOf<AActor> ActorClass;
+
+	/** Number of actors spawned into the pool when play begins */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Pooling", meta = (ClampMin = "0"))
+	int32 PrewarmCount = 0;
+
+	/** Most released actors the pool keeps. Actors released past this are destroyed */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Pooling", meta = (ClampMin = "0"))
+	int32 MaxPooledActors = 32;
+};
+
+/**
+ * Inactive actors of one pooled class, waiting to be spawned again
+ */
+USTRUCT()
+struct FSpawnPool
+{
+	GENERATED_BODY()
+
+	/** Hidden actors with collision and ticking turned off */
+	UPROPERTY()
+	TArray<AActor *> InactiveActors;
+
+	/** Most actors kept in InactiveActors */
+	int32 MaxPooledActors = 0;
+};
+
 UCLASS(BlueprintType, Blueprintable,meta=(ShortTooltip="Spawns a given class at the nearest spawn point location."))
 class ASpawner : public AActor
 {
@@ -40,6 +108,122 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Spawning")
 	void SpawnAtNearestLocation(FVector2D Location, TSubclassOf<AActor> ActorToSpawn, UPARAM(DisplayName="Spawned Actor") AActor* &SpawnedActor_out, ESpawnActorCollisionHandlingMethod SpawnMethod = ESpawnActorCollisionHandlingMethod::Undefined);
 
+	/**
+	 * Spawns the given actor subclass at a location nearest to the one passed in, including its height. Only the Oct
+	 * Tree index uses the height, the quad tree indexes ignore it.
+	 *
+	 * @param Location Nearest position to spawn the object
+	 * @param ActorToSpawn Actor subclass to spawn
+	 * @param SpawnMethod Collision behavior when spawning the object
+	 *
+	 * @returns Spawned Actor object reference
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Spawning")
+	void SpawnAtNearestLocation3D(FVector Location, TSubclassOf<AActor> ActorToSpawn, UPARAM(DisplayName="Spawned Actor") AActor* &SpawnedActor_out, ESpawnActorCollisionHandlingMethod SpawnMethod = ESpawnActorCollisionHandlingMethod::Undefined);
+
+	/**
+	 * Spawns one actor at the spawn point nearest to each of a list of locations. The nearest spawn points are all
+	 * found at once across worker threads before anything is spawned.
+	 *
+	 * @param Locations Nearest positions to spawn the objects
+	 * @param ActorToSpawn Actor subclass to spawn
+	 * @param SpawnedActors_out Spawned actor for each location, at the same index, or NULL where nothing was spawned
+	 * @param SpawnMethod Collision behavior when spawning the objects
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Spawning")
+	void SpawnAtNearestLocations(const TArray<FVector2D> &Locations, TSubclassOf<AActor> ActorToSpawn, UPARAM(DisplayName="Spawned Actors") TArray<AActor*> &SpawnedActors_out, ESpawnActorCollisionHandlingMethod SpawnMethod = ESpawnActorCollisionHandlingMethod::Undefined);
+
+	/**
+	 * Spawns a group of actors at the spawn points nearest to one location, one actor per spawn point. The spawn points
+	 * are found with a single nearest neighbour search and reserved together, so no two actors of the batch, or of
+	 * any other batch, share a spawn point. Each actor holds its spawn point until the actor is handed to ReleaseActor
+	 * or destroyed, or until the spawn point is released by hand.
+	 *
+	 * @param Location Position to spawn the group around
+	 * @param ActorToSpawn Actor subclass to spawn
+	 * @param Count Number of actors to spawn
+	 * @param SpawnedActors_out Spawned actors, nearest spawn point first. Shorter than Count if too few spawn points were free
+	 * @param SpawnMethod Collision behavior when spawning the objects
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Spawning")
+	void SpawnBatchAtNearestLocations(FVector2D Location, TSubclassOf<AActor> ActorToSpawn, int32 Count, UPARAM(DisplayName="Spawned Actors") TArray<AActor*> &SpawnedActors_out, ESpawnActorCollisionHandlingMethod SpawnMethod = ESpawnActorCollisionHandlingMethod::Undefined);
+
+	/**
+	 * Gets whether a spawn point has been reserved by a batch spawn and not released yet
+	 *
+	 * @param SpawnPoint Spawn point to check
+	 *
+	 * @returns True if the spawn point is reserved
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Spawning")
+	bool IsSpawnPointReserved(AActor *SpawnPoint) const;
+
+	/**
+	 * Frees a spawn point reserved by a batch spawn so it can be used again. The actor spawned there stops holding it
+	 *
+	 * @param SpawnPoint Spawn point to release
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Spawning")
+	void ReleaseSpawnPoint(AActor *SpawnPoint);
+
+	/**
+	 * Frees every spawn point reserved by batch spawns
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Spawning")
+	void ReleaseAllSpawnPoints();
+
+	/**
+	 * Keeps a spawn point from being spawned at for a while. Spawn points stop being found by nearest and random
+	 * searches at once and come back on their own once the cooldown ends
+	 *
+	 * @param SpawnPoint Spawn point to close
+	 * @param Duration Seconds of game time the spawn point stays closed. A shorter cooldown never cuts a longer one short
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Spawning")
+	void StartSpawnPointCooldown(AActor *SpawnPoint, float Duration);
+
+	/**
+	 * Gets whether a spawn point is closed by a cooldown
+	 *
+	 * @param SpawnPoint Spawn point to check
+	 *
+	 * @returns True if the spawn point's cooldown has not ended yet
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Spawning")
+	bool IsSpawnPointCoolingDown(AActor *SpawnPoint) const;
+
+	/**
+	 * Queues an actor to be spawned at a location nearest to the one passed in. Queued spawns are handled in order
+	 * during Tick, as many each frame as MaxQueuedSpawnsPerFrame and QueuedSpawnBudgetMs allow, and OnQueuedSpawnComplete
+	 * is called for each one
+	 *
+	 * @param Location Nearest position to spawn the object
+	 * @param ActorToSpawn Actor subclass to spawn
+	 * @param SpawnMethod Collision behavior when spawning the object
+	 *
+	 * @returns Id passed to OnQueuedSpawnComplete when the spawn is handled
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Spawning")
+	int32 QueueSpawnAtNearestLocation(FVector2D Location, TSubclassOf<AActor> ActorToSpawn, ESpawnActorCollisionHandlingMethod SpawnMethod = ESpawnActorCollisionHandlingMethod::Undefined);
+
+	/**
+	 * Gets the number of queued spawns not handled yet
+	 *
+	 * @returns Number of spawns waiting in the queue
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Spawning")
+	int32 GetNumQueuedSpawns() const;
+
+	/**
+	 * Hands back an actor this spawner spawned once it is no longer needed. Actors of a pooled class are hidden and
+	 * kept to be spawned again, anything else is destroyed. The spawn point a batch spawn reserved for the actor is
+	 * released with it
+	 *
+	 * @param SpawnedActor Actor to release
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Spawning")
+	void ReleaseActor(AActor *SpawnedActor);
+
 	/**
 	 * Spawns an actor at a random location from the list of possible spawn points
 	 *
@@ -62,13 +246,107 @@ public:
 	void SpawnAtRandomLocation(TSubclassOf<AActor> ActorToSpawn, UPARAM(DisplayName="Spawned Actor") AActor* &SpawnedActor_out, ESpawnActorCollisionHandlingMethod SpawnMethod = ESpawnActorCollisionHandlingMethod::Undefined);
 
 	/**
-	 * Gets all active spawn points currently a part of this spawner
+	 * Spawns an actor at a random spawn point within a radius of a location but at least a distance away from
+	 * another. Spawn points are picked in proportion to their SpawnWeight. Pass the same location twice for a ring,
+	 * or an exclusion radius of zero for a plain circle. Heights are ignored.
+	 *
+	 * @param Center Center of the area to spawn in
+	 * @param Radius Radius of the area to spawn in
+	 * @param ExcludeCenter Center of the area to keep clear
+	 * @param ExcludeRadius Distance spawn points must be from ExcludeCenter, zero to keep nothing clear
+	 * @param ActorToSpawn Actor subclass to spawn
+	 * @param SpawnMethod Collision behavior when spawning the object
+	 *
+	 * @returns Spawned Actor object reference, or NULL if no open spawn point is in the area
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Spawning")
+	void SpawnAtRandomLocationInRegion(FVector2D Center, float Radius, FVector2D ExcludeCenter, float ExcludeRadius, TSubclassOf<AActor> ActorToSpawn, UPARAM(DisplayName="Spawned Actor") AActor* &SpawnedActor_out, ESpawnActorCollisionHandlingMethod SpawnMethod = ESpawnActorCollisionHandlingMethod::Undefined);
+
+	/**
+	 * Gets all active spawn points currently a part of this spawner. Safe to call from any thread
 	 *
 	 * @returns A list of active spawn points
 	 */
 	UFUNCTION(BlueprintCallable)
 	TArray<AActor *> GetAllSpawnPoints();
 
+	/**
+	 * Gets all spawn points within a radius of a location, at any height. Safe to call from any thread
+	 *
+	 * @param Location Center of the search area
+	 * @param Radius Radius of the search area
+	 *
+	 * @returns A list of spawn points inside the search area
+	 */
+	UFUNCTION(BlueprintCallable)
+	TArray<AActor *> GetSpawnPointsInRadius(FVector2D Location, float Radius);
+
+	/**
+	 * Finds the spawn point closest to a location. Height is only used by the Oct Tree index. Safe to call from any
+	 * thread, since every query runs without locking against the most recently published spawn points. The Quad Tree
+	 * and Oct Tree indexes skip spawn points that are reserved or cooling down
+	 *
+	 * @param Location Position to search around
+	 *
+	 * @returns The nearest spawn point, or NULL if there are none
+	 */
+	AActor* FindNearestSpawnPoint(FVector Location) const;
+
+	/**
+	 * Finds the spawn point closest to each of a list of locations, spreading the searches across worker threads.
+	 * Height is only used by the Oct Tree index. Safe to call from any thread
+	 *
+	 * @param Locations Positions to search around
+	 * @param OutNearest Nearest spawn point to each location, at the same index, or NULL if there are none
+	 */
+	void FindNearestSpawnPoints(TArrayView<const FVector> Locations, TArrayView<AActor*> OutNearest) const;
+
+	/**
+	 * Gets whether a location is inside the bounds of any no spawn zone, at any height
+	 *
+	 * @param Location Position to test
+	 *
+	 * @returns True if spawning at the location is blocked
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Spawning")
+	bool IsInNoSpawnZone(FVector Location) const;
+
+	/**
+	 * Adds a no spawn zone, or refits one already added to its current bounds. Game thread only
+	 *
+	 * @param Zone Actor whose bounds block spawning
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Spawning")
+	void AddNoSpawnZone(AActor *Zone);
+
+	/**
+	 * Removes a no spawn zone so spawning is allowed inside it again. Game thread only
+	 *
+	 * @param Zone Actor previously added as a no spawn zone
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Spawning")
+	void RemoveNoSpawnZone(AActor *Zone);
+
+	/**
+	 * Rebuilds the spatial index from the spawn points in the level. Spawn points still in the level keep their
+	 * reservations and cooldowns
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Spawning")
+	void RebuildSpawnIndex();
+
+#if WITH_EDITOR
+	/**
+	 * Builds the spatial index from the spawn points in the level and stores it with the spawner, so play can start
+	 * without building it again
+	 */
+	UFUNCTION(CallInEditor, Category = "Spawning Options")
+	void BakeSpawnIndex();
+
+	/**
+	 * Bakes the spawn index before the level is saved or cooked when bUseBakedSpawnIndex is set
+	 */
+	virtual void PreSave(const class ITargetPlatform *TargetPlatform) override;
+#endif
 
 	/**
 	 *Called every frame
@@ -90,7 +368,386 @@ public:
 	UPROPERTY(EditAnywhere, Category = "Spawning Options")
 	bool bAutoAddAllSpawnPoints;
 
+	/** Spatial index used to store and search the spawn points */
+	UPROPERTY(EditAnywhere, Category = "Spawning Options")
+	ESpawnPointIndex SpawnPointIndex;
+
+	/** Number of spawn points a node of the spatial index holds before it splits. Bigger leaves give a shallower tree but more spawn points to scan in each node */
+	UPROPERTY(EditAnywhere, Category = "Spawning Options", meta = (ClampMin = "1"))
+	int32 LeafCapacity;
+
+	/** Deepest level the spatial index splits to. Leaves at this level keep every spawn point that reaches them */
+	UPROPERTY(EditAnywhere, Category = "Spawning Options", meta = (ClampMin = "0", ClampMax = "16"))
+	int32 MaxTreeDepth;
+
+	/** Smallest size a node of the spatial index can be split into, which keeps spawn points that share a location in one leaf */
+	UPROPERTY(EditAnywhere, Category = "Spawning Options", meta = (ClampMin = "0"))
+	float MinCellSize;
+
+	/** If true, the spatial index is baked into the level whenever it is saved or cooked and loaded from there at the start of play instead of being built. It is checked against the level in the background and rebuilt if they differ */
+	UPROPERTY(EditAnywhere, Category = "Spawning Options")
+	bool bUseBakedSpawnIndex;
+
+	/** Actors whose bounds block spawning. Spawn points inside any of them are skipped for the nearest open one */
+	UPROPERTY(EditAnywhere, Category = "Spawning Options")
+	TArray<AActor *> NoSpawnZones;
+
+	/** Most queued spawns handled in one frame, or 0 for no limit */
+	UPROPERTY(EditAnywhere, Category = "Spawning Options", meta = (ClampMin = "0"))
+	int32 MaxQueuedSpawnsPerFrame;
+
+	/** Milliseconds each frame may spend on queued spawns, or 0 for no limit. At least one queued spawn is handled every frame */
+	UPROPERTY(EditAnywhere, Category = "Spawning Options", meta = (ClampMin = "0"))
+	float QueuedSpawnBudgetMs;
+
+	/** Seconds a spawn point stays closed after something is spawned at it, or 0 to let it be used again at once */
+	UPROPERTY(EditAnywhere, Category = "Spawning Options", meta = (ClampMin = "0"))
+	float SpawnPointCooldown;
+
+	/** Classes whose actors are kept in a pool when released and reused instead of spawning new ones */
+	UPROPERTY(EditAnywhere, Category = "Spawning Options")
+	TArray<FSpawnPoolSettings> PooledClasses;
+
+	/** Called for every queued spawn once it has been handled */
+	UPROPERTY(BlueprintAssignable, Category = "Spawning")
+	FOnQueuedSpawnComplete OnQueuedSpawnComplete;
+
+	/** Spawn points the baked spawn index was built from, in the order it refers to them by */
+	UPROPERTY()
+	TArray<TSoftObjectPtr<AActor>> BakedSpawnPoints;
+
+	/** Spatial index written by BakeSpawnIndex, behind a header naming its version and layout */
+	UPROPERTY()
+	TArray<uint8> BakedSpawnIndex;
+
 private:
-	/** Underlying QTree structure to store all of spawn points */
-	class QTree *tree;
+	/**
+	 * Gets a 2D location at the height of the spawner
+	 *
+	 * @param Location 2D location
+	 *
+	 * @returns The location with the spawner's Z
+	 */
+	FVector GetLocationAtSpawnerHeight(FVector2D Location) const;
+
+	/**
+	 * Finds the spawn point closest to a location that is open
+	 *
+	 * @param Location Position to search around
+	 *
+	 * @returns The nearest open spawn point, or NULL if there are none
+	 */
+	AActor* FindNearestOpenSpawnPoint(FVector Location) const;
+
+	/**
+	 * Finds the open spawn points closest to a location, nearest first
+	 *
+	 * @param Location Position to search around
+	 * @param OutNearest Filled with up to OutNearest.Num() open spawn points, and NULL past the ones found
+	 *
+	 * @returns Number of open spawn points found
+	 */
+	int32 FindNearestOpenSpawnPoints(FVector Location, TArrayView<AActor*> OutNearest) const;
+
+	/**
+	 * Gets whether a spawn point can be spawned at, meaning it is not reserved, cooling down or inside a no spawn zone
+	 *
+	 * @param SpawnPoint Spawn point to check
+	 *
+	 * @returns True if the spawn point is open
+	 */
+	bool IsSpawnPointOpen(AActor *SpawnPoint) const;
+
+	/**
+	 * Finds the open spawn points closest to a location and reserves them, all in one step
+	 *
+	 * @param Location Position to search around
+	 * @param OutReserved Filled with up to OutReserved.Num() reserved spawn points, nearest first
+	 *
+	 * @returns Number of spawn points reserved
+	 */
+	int32 ReserveNearestSpawnPoints(FVector Location, TArrayView<AActor*> OutReserved);
+
+	/**
+	 * Picks a spawn point uniformly at random with a single walk down the spatial index. Safe to call from any thread.
+	 * The Quad Tree and Oct Tree indexes only pick from spawn points that are not reserved or cooling down
+	 *
+	 * @returns The spawn point, or NULL if there are none
+	 */
+	AActor* GetRandomSpawnPoint() const;
+
+	/**
+	 * Picks a random open spawn point without allocating. When a few draws in a row are blocked it settles for the
+	 * open spawn point nearest the last one drawn
+	 *
+	 * @returns The spawn point, or NULL if every spawn point is blocked
+	 */
+	AActor* PickRandomOpenSpawnPoint();
+
+	/**
+	 * Picks a spawn point at random, weighted by SpawnWeight, from the spawn points within a radius of a location and
+	 * at least a distance away from another. The quad and oct trees answer in one pass that skips every node outside
+	 * the area. Safe to call from any thread
+	 *
+	 * @param Center Center of the area
+	 * @param Radius Radius of the area
+	 * @param ExcludeCenter Center of the area to keep clear
+	 * @param ExcludeRadius Distance spawn points must be from ExcludeCenter
+	 *
+	 * @returns The spawn point, or NULL if there are none in the area
+	 */
+	AActor* GetRandomSpawnPointInRegion(FVector2D Center, float Radius, FVector2D ExcludeCenter, float ExcludeRadius) const;
+
+	/**
+	 * Picks a random spawn point in an area like GetRandomSpawnPointInRegion, skipping spawn points inside a no spawn zone
+	 *
+	 * @returns The spawn point, or NULL if every spawn point in the area is blocked
+	 */
+	AActor* PickRandomOpenSpawnPointInRegion(FVector2D Center, float Radius, FVector2D ExcludeCenter, float ExcludeRadius);
+
+	/**
+	 * Visits every spawn point in an area with the weight the spatial index holds for it, tested against the position
+	 * the index holds. The linear tree keeps no weights, so each spawn point's SpawnWeight is read instead
+	 *
+	 * @param Center Center of the area
+	 * @param Radius Radius of the area
+	 * @param ExcludeCenter Center of the area to keep clear
+	 * @param ExcludeRadius Distance spawn points must be from ExcludeCenter
+	 * @param Visitor Called as bool(AActor*, float Weight) for each spawn point, return false to stop
+	 */
+	template<typename VisitorType>
+	void VisitSpawnPointsInRegion(FVector2D Center, float Radius, FVector2D ExcludeCenter, float ExcludeRadius, VisitorType &&Visitor) const;
+
+	/**
+	 * Picks a spawn point in an area at random, weighted by the weights the spatial index holds, by adding the weights up
+	 * and then walking them again to where a single random draw lands. Nothing is allocated
+	 *
+	 * @param Center Center of the area
+	 * @param Radius Radius of the area
+	 * @param ExcludeCenter Center of the area to keep clear
+	 * @param ExcludeRadius Distance spawn points must be from ExcludeCenter
+	 * @param Filter Called as bool(AActor*) for each spawn point, return false to leave it out
+	 *
+	 * @returns The spawn point, or NULL if there are none left in the area
+	 */
+	template<typename FilterType>
+	AActor* PickWeightedSpawnPointInRegion(FVector2D Center, float Radius, FVector2D ExcludeCenter, float ExcludeRadius, FilterType &&Filter) const;
+
+	/**
+	 * Gets the spawn points added manually and, if bAutoAddAllSpawnPoints is set, every spawn point in the level
+	 *
+	 * @returns The spawn points, without empty entries
+	 */
+	TArray<AActor*> GatherSpawnPoints() const;
+
+	/**
+	 * Gives every spawn point its reservation and cooldown bits. Spawn points that already had bits keep them, new
+	 * ones start open, and spawn points no longer in the list lose theirs
+	 *
+	 * @param AllSpawnPoints Spawn points the spatial index holds
+	 */
+	void UpdateSpawnPointState(const TArray<AActor*> &AllSpawnPoints);
+
+	/**
+	 * Enables or disables a spawn point in the published quad or oct tree to match its reservation and cooldown bits,
+	 * so queries skip it and every subtree with nothing open. The tree is changed in place without a copy. The linear
+	 * tree has no enabled bits and is left alone. Must be called holding reservationLock
+	 *
+	 * @param StateIndex Index of the spawn point's bits
+	 */
+	void SyncSpawnPointEnabled(int32 StateIndex);
+
+	/**
+	 * Builds the spatial index chosen by SpawnPointIndex and publishes it, with every reserved or cooling spawn point
+	 * already disabled
+	 *
+	 * @param AllSpawnPoints Spawn points to put in the index
+	 */
+	void BuildSpawnIndex(const TArray<AActor*> &AllSpawnPoints);
+
+	/**
+	 * Publishes the baked spatial index without building it
+	 *
+	 * @param OutSpawnPoints Filled with the spawn points the baked index refers to
+	 *
+	 * @returns False if there is no baked index for SpawnPointIndex, it was written by another version or with other
+	 * split settings, or one of its spawn points no longer exists
+	 */
+	bool LoadBakedSpawnIndex(TArray<AActor*> &OutSpawnPoints);
+
+	/**
+	 * Checks the baked spatial index against the spawn points in the level. The spawn points themselves are compared
+	 * right away and the index rebuilt at once if they differ. Their positions are then checked on a worker thread,
+	 * and the index rebuilt on the game thread if any has moved
+	 *
+	 * @param BakedActors Spawn points the baked index refers to
+	 */
+	void ValidateBakedSpawnIndex(const TArray<AActor*> &BakedActors);
+
+	/**
+	 * Spawns an actor at a spawn point, reusing one from its class's pool when there is one
+	 *
+	 * @param ActorToSpawn Actor subclass to spawn
+	 * @param SpawnPoint Spawn point whose transform the actor is placed at
+	 * @param Params Parameters used when a new actor has to be spawned
+	 *
+	 * @returns Spawned Actor object reference
+	 */
+	AActor* AcquireActor(TSubclassOf<AActor> ActorToSpawn, AActor *SpawnPoint, const FActorSpawnParameters &Params);
+
+	/**
+	 * Spawns the actors each pool starts with, out of sight at the spawner
+	 */
+	void PrewarmPools();
+
+	/**
+	 * Records that a batch spawned actor holds its reserved spawn point, so releasing or destroying the actor releases
+	 * the spawn point too
+	 *
+	 * @param SpawnedActor Actor spawned at the spawn point
+	 * @param SpawnPoint Spawn point reserved for the actor
+	 */
+	void HoldSpawnPoint(AActor *SpawnedActor, AActor *SpawnPoint);
+
+	/**
+	 * Releases the spawn point an actor holds, unless it was released by hand and reserved again since
+	 *
+	 * @param SpawnedActor Actor that may hold a spawn point
+	 */
+	void ReleaseHeldSpawnPoint(AActor *SpawnedActor);
+
+	/**
+	 * Releases the spawn point of an actor destroyed without going through ReleaseActor
+	 *
+	 * @param DestroyedActor Actor being destroyed
+	 */
+	UFUNCTION()
+	void OnHolderDestroyed(AActor *DestroyedActor);
+
+	/**
+	 * Reopens every spawn point whose cooldown has ended, visiting only the wheel slots that have come due since the
+	 * last call. Game thread only
+	 */
+	void ExpireCooldowns();
+
+	/**
+	 * Handles queued spawns until this frame's budget runs out. The spawn points for the whole frame are found in one
+	 * batch before anything is spawned
+	 */
+	void ProcessSpawnQueue();
+
+	/**
+	 * Spawn waiting in the queue
+	 */
+	struct FQueuedSpawn
+	{
+		/** Id handed back to the caller */
+		int32 RequestId;
+
+		/** Nearest position to spawn the object, at the spawner's height */
+		FVector Location;
+
+		/** Actor subclass to spawn */
+		TSubclassOf<AActor> ActorToSpawn;
+
+		/** Collision behavior when spawning the object */
+		ESpawnActorCollisionHandlingMethod SpawnMethod;
+
+		/** Time the spawn was queued, used to measure how long it waited */
+		double QueueTime;
+	};
+
+	/**
+	 * Cooldown waiting in a slot of the cooldown wheel
+	 */
+	struct FSpawnPointCooldown
+	{
+		/** Spawn point cooling down */
+		AActor *SpawnPoint;
+
+		/** Game time the cooldown ends at */
+		float EndTime;
+	};
+
+	/** Number of slots in the cooldown wheel. Cooldowns longer than a full turn wait in their slot for later turns */
+	static const int32 NumCooldownSlots = 64;
+
+	/** Seconds of game time each slot of the cooldown wheel covers */
+	static constexpr float CooldownSlotSeconds = 0.25f;
+
+	/** Written at the start of BakedSpawnIndex so anything else stored there is never read as an index */
+	static const uint32 BakedSpawnIndexMagic = 0x58495053;
+
+	/** Version of BakedSpawnIndex's header. Bump it whenever the header changes so older bakes are rebuilt instead */
+	static const uint32 BakedSpawnIndexVersion = 2;
+
+	/** Distance a spawn point may have moved from its baked position before the baked index is rebuilt */
+	static constexpr float BakedPositionTolerance = 1.f;
+
+	/** Number of random spawn points tried before the open random picks fall back to a search */
+	static const int32 MaxRandomPickAttempts = 16;
+
+	/** Number of queued spawns whose nearest spawn points are found together when MaxQueuedSpawnsPerFrame is 0 */
+	static const int32 QueuedSpawnChunkSize = 16;
+
+	/**
+	 * Published QTree storing all of the spawn points. It is only ever replaced as a whole, and reservations and
+	 * cooldowns are kept out of it so they never cause a copy
+	 */
+	TUniquePtr<TSpatialSnapshot<QTree>> tree;
+
+	/** Published LinearQTree used instead of the QTree when SpawnPointIndex is LinearQuadTree */
+	TUniquePtr<TSpatialSnapshot<LinearQTree>> linearTree;
+
+	/** Published OctTree used instead of the QTree when SpawnPointIndex is OctTree */
+	TUniquePtr<TSpatialSnapshot<OctTree>> octTree;
+
+	/** Loose quad tree of the bounds of every no spawn zone */
+	TUniquePtr<LooseQTree> noSpawnZones;
+
+	/**
+	 * Index of each spawn point's bit in reservedSpawnPoints. Replaced along with the bits whenever the spatial index
+	 * is rebuilt, so it is only read under reservationLock
+	 */
+	TMap<AActor *, int32> spawnPointIndices;
+
+	/**
+	 * Set for every spawn point reserved by a batch spawn. The quad and oct trees disable every reserved or cooling spawn
+	 * point in place, the linear tree only filters on the bits
+	 */
+	TBitArray<> reservedSpawnPoints;
+
+	/** Spawn point each bit belongs to, at the same index as reservedSpawnPoints */
+	TArray<AActor *> indexedSpawnPoints;
+
+	/** Actor each reserved spawn point was handed to by a batch spawn, at the same index as reservedSpawnPoints */
+	TArray<AActor *> spawnPointHolders;
+
+	/** Spawn point each batch spawned actor holds. Game thread only */
+	TMap<AActor *, AActor *> heldSpawnPoints;
+
+	/** Set for every spawn point whose cooldown has not ended yet, at the same index as reservedSpawnPoints */
+	TBitArray<> coolingSpawnPoints;
+
+	/** Game time each spawn point's cooldown ends at */
+	TArray<float> cooldownEndTimes;
+
+	/** Cooldowns sorted into slots by the time they end, so ending them only touches the slots that have come due */
+	TArray<FSpawnPointCooldown> cooldownWheel[NumCooldownSlots];
+
+	/** Slot of the cooldown wheel the last update stopped in, counted from the start of the game */
+	int32 lastCooldownSlot;
+
+	/** Makes finding and reserving spawn points a single step, and guards spawnPointIndices and the cooldown bits */
+	mutable FCriticalSection reservationLock;
+
+	/** Pool of each class in PooledClasses */
+	UPROPERTY()
+	TMap<UClass *, FSpawnPool> actorPools;
+
+	/** Spawns waiting for Tick, oldest first */
+	TArray<FQueuedSpawn> spawnQueue;
+
+	/** Id given to the next queued spawn */
+	int32 nextSpawnRequestId;
 };
@@ -0,0 +1,55 @@
+// Copyright (c) 2018 Ryan Dougherty. All rights reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * FSplitPolicy decides when a node of a spatial tree splits into children. One policy is shared by every node of a
+ * tree, so child nodes always follow the same rules as their root.
+ */
+struct FSplitPolicy
+{
+	/** Number of Actors a node holds before it splits */
+	int32 LeafCapacity = 16;
+
+	/** Deepest level a node can split to, where the root is level 0. Nodes at this level keep every Actor that reaches them */
+	int32 MaxDepth = 16;
+
+	/**
+	 * Smallest size a child node can have. A node that cannot split without going under it keeps every Actor that
+	 * reaches it, which stops Actors sharing a position from splitting the tree until floats run out
+	 */
+	float MinCellSize = 1.f;
+
+	/**
+	 * Default constructor for the default policy
+	 */
+	FSplitPolicy()
+	{
+	}
+
+	/**
+	 * Constructor for a policy with explicit limits
+	 *
+	 * @param InLeafCapacity Number of Actors a node holds before it splits
+	 * @param InMaxDepth Deepest level a node can split to
+	 * @param InMinCellSize Smallest size a child node can have
+	 */
+	FSplitPolicy(int32 InLeafCapacity, int32 InMaxDepth = 16, float InMinCellSize = 1.f)
+		: LeafCapacity(FMath::Max(InLeafCapacity, 1)), MaxDepth(FMath::Max(InMaxDepth, 0)), MinCellSize(FMath::Max(InMinCellSize, 0.f))
+	{
+	}
+
+	/**
+	 * Gets whether a node is allowed to split into children
+	 *
+	 * @param Depth Level of the node, where the root is level 0
+	 * @param Size Length of the node's longest side
+	 * @returns True if the node is above the maximum depth and its children would not be smaller than the minimum cell size
+	 */
+	FORCEINLINE bool CanSplit(int32 Depth, float Size) const
+	{
+		return Depth < MaxDepth && Size * 0.5f >= MinCellSize;
+	}
+};